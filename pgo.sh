@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+# Profile guided, link time optimized Release build of zkb and zkb_bench.
+#   1. Builds instrumented binaries (ZKB_PGO=GENERATE)
+#   2. Trains them: synthetic projects of different shapes, a scripted editing session
+#      in each, export/import and a short zkb_bench run
+#   3. Rebuilds in the same directory with the profiles and LTO (ZKB_PGO=USE)
+# Use: ./pgo.sh [build directory (build-pgo)]
+set -euo pipefail
+
+source=$(cd "$(dirname "$0")" && pwd)
+build=$(realpath -m "${1:-$source/build-pgo}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+cmake -S "$source" -B "$build" -DCMAKE_BUILD_TYPE=Release -DZKB_PGO=GENERATE -DZKB_LTO=OFF
+cmake --build "$build" -j"$(nproc)" --clean-first
+find "$build" -name '*.gcda' -delete
+rm -rf "$build/pgo"
+
+zkb="$build/zkb"
+
+# Editing session run in every block of the training projects, stdin answers prompts with nothing
+session()
+{
+    cat <<'COMMANDS'
+ls
+ls -a
+-ls
+status
+status -r
+tree 2
+l training
+3 l repeated 2
+l $ 1
+c renamed 1
+c 2 1
+-c ranged (1,2)
+s 1 3
+s 2
+-s (1,2) 4
+y (1,3)
+p 5
+y 2
+2 p
+info 3
+info -r 1
+find line
+find ^[0-9]+ -r
+index build
+find training
+l indexed 1
+find indexed
+index off
+cd 1
+l nested
+ls
+cd ..
+cd /1
+cd /
+d 1
+d 2
+u
+u
+storage hybrid
+cd 1
+cd ..
+ls
+storage dirs
+stats
+help
+q
+COMMANDS
+}
+
+while read -r seed lines breadth depth blocks; do
+    project="$work/train$seed.zkb"
+    "$zkb" gen "$project" --seed "$seed" --lines "$lines" --breadth "$breadth" --depth "$depth" --blocks "$blocks"
+
+    (cd "$project" && session | "$zkb" > /dev/null 2>&1)
+    (cd "$project" && session | "$zkb" --json > /dev/null 2>&1)
+
+    "$zkb" export "$project" -o "$work/train$seed.txt"
+    mkdir "$work/import$seed.zkb"
+    "$zkb" import "$work/train$seed.txt" "$work/import$seed.zkb" > /dev/null
+done <<'PROJECTS'
+1 2000 8 4 0.3
+2 20000 200 1 0.05
+3 5000 3 10 0.6
+4 50000 1000 2 0.1
+PROJECTS
+
+"$build/zkb_bench" --dir "$work" --sizes 10,1000,10000 --runs 10 --budget 3 > /dev/null
+
+# clang writes raw profiles that have to be merged, gcc's .gcda files are used as they are
+if compgen -G "$build/pgo/*.profraw" > /dev/null; then
+    llvm-profdata merge -output="$build/pgo/zkb.profdata" "$build"/pgo/*.profraw
+fi
+
+cmake -S "$source" -B "$build" -DZKB_PGO=USE -DZKB_LTO=ON
+cmake --build "$build" -j"$(nproc)" --clean-first
+
+echo "Profile guided build in $build"
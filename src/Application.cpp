@@ -1,11 +1,18 @@
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string_view>
 
 #include "Application.hpp"
 #include "CommandHandler.hpp"
+#include "Daemon.hpp"
+#include "Generator.hpp"
 #include "Helper.hpp"
+#include "ProjectIO.hpp"
+#include "Session.hpp"
+#include "Trace.hpp"
 
 namespace fs = std::filesystem;
 
@@ -22,6 +29,13 @@ Application::Application(char** _argv, int _argc) :
     {
         std::cout << "\nUse: \"zkb help (keyword)\" for project/compiler help\n"
         "Run the tooling with: \"zkb\" and use: \"help\" for tooling help\n" 
+        "Use: \"zkb import file.txt [path]\" to create lines from indented text\n"
+        "Use: \"zkb export [path] [-o file.txt]\" to write lines as indented text\n"
+        "Use: \"zkb gen path.zkb [--seed #] [--lines #] ...\" to create a synthetic project\n"
+        "Use: \"zkb --json\" to run the tooling with one JSON record per command\n"
+        "Use: \"zkb --trace out.json [command]\" to write Chrome trace events of a session\n"
+        "Use: \"zkb --record session.log\" and \"zkb replay session.log\" to rerun a session with timings\n"
+        "Use: \"zkb daemon\" to keep a session alive and \"zkb do command...\" to run commands in it\n"
         "keywords:\n";
 
         for (const auto& str : keywords)
@@ -34,6 +48,47 @@ Application::Application(char** _argv, int _argc) :
         ;
     };
 
+    //Options before the command, argv is shifted past them
+    bool json = false;
+    while (argc > 1 and std::string_view(argv[1]).starts_with("--"))
+    {
+        const std::string_view option = argv[1];
+        if (option == "--json")
+        {
+            json = true;
+        }
+        else if (option == "--trace" and argc > 2)
+        {
+            if (!zkb::Trace::Start(argv[2])) Exit(EXIT_FAILURE);
+            argv += 1;
+            argc -= 1;
+        }
+        else if (option == "--record" and argc > 2)
+        {
+            if (!zkb::Session::Record(argv[2])) Exit(EXIT_FAILURE);
+            argv += 1;
+            argc -= 1;
+        }
+        else
+        {
+            break;
+        }
+        argv += 1;
+        argc -= 1;
+    }
+
+    if (argc == 1 and json)
+    {
+        //Tooling for scripts: no prompt, one JSON record per command line
+        CommandHandler handler(false);
+        if (!handler.SetupRoot()) Exit(EXIT_FAILURE);
+
+        handler.showPrompt = false;
+        handler.jsonOutput = true;
+        handler.Run();
+        return;
+    }
+
     if (argc == 1)
     {
         //Run tooling
@@ -47,6 +102,30 @@ Application::Application(char** _argv, int _argc) :
     {
         Build();
     }
+    else if (first == "import")
+    {
+        Import();
+    }
+    else if (first == "export")
+    {
+        Export();
+    }
+    else if (first == "gen")
+    {
+        Generate();
+    }
+    else if (first == "replay")
+    {
+        Replay();
+    }
+    else if (first == "daemon")
+    {
+        Daemon();
+    }
+    else if (first == "do")
+    {
+        Send();
+    }
     else if (first == "help")
     {
         if (argc != 3)
@@ -70,6 +149,214 @@ void Application::Build()
     std::cerr << "Not implemented.\n";
 }
 
+/**
+ * Creates the lines of an indentation-structured text file in a block.
+ * zkb import file.txt [path], path defaults to the current directory
+ */
+void Application::Import()
+{
+    if (argc < 3 or argc > 4)
+    {
+        std::cerr << "Use: zkb import file.txt [path]\n";
+        Exit(EXIT_FAILURE);
+    }
+
+    const fs::path destination = argc == 4? fs::absolute(argv[3]) : fs::current_path();
+    if (zkb::ProjectIO::FindRoot(destination).empty())
+    {
+        CommandHandler::WrongUsage(CommandHandler::Setup::RootDirectory, true);
+    }
+
+    if (!zkb::ProjectIO::Import(argv[2], destination)) Exit(EXIT_FAILURE);
+}
+
+/**
+ * Writes the lines under a block as indented text, the inverse of import.
+ * zkb export [path] [-o file.txt], stdout when no file is given
+ */
+void Application::Export()
+{
+    fs::path    source = fs::current_path();
+    const char* output = nullptr;
+
+    for (int i = 2; i < argc; i += 1)
+    {
+        const std::string_view current = argv[i];
+        if (current == "-o" and i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            source = fs::absolute(current);
+        }
+    }
+
+    if (zkb::ProjectIO::FindRoot(source).empty())
+    {
+        CommandHandler::WrongUsage(CommandHandler::Setup::RootDirectory, true);
+    }
+
+    bool success;
+    if (output != nullptr)
+    {
+        std::ofstream file(output, std::ios::binary);
+        success = file and zkb::ProjectIO::Export(source, file);
+    }
+    else
+    {
+        std::ios::sync_with_stdio(false);
+        success = zkb::ProjectIO::Export(source, std::cout);
+    }
+
+    if (!success)
+    {
+        std::cerr << "Export failed\n";
+        Exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Creates a new project filled with generated lines, the same seed gives the same project.
+ * zkb gen path.zkb [--seed #] [--lines #] [--breadth #] [--depth #] [--blocks 0-1]
+ *                  [--length mean,max] [--collisions 0-1]
+ */
+void Application::Generate()
+{
+    const auto usage = []()
+    {
+        std::cerr << "Use: zkb gen path.zkb [--seed #] [--lines #] [--breadth #] [--depth #] [--blocks 0-1]\n"
+                     "                      [--length mean,max] [--collisions 0-1]\n";
+        Exit(EXIT_FAILURE);
+    };
+
+    if (argc < 3) usage();
+
+    const fs::path destination = fs::absolute(argv[2]);
+    if (destination.extension() != ".zkb")
+    {
+        std::cerr << "Project path must end with .zkb\n";
+        Exit(EXIT_FAILURE);
+    }
+
+    zkb::Generator::Options options;
+    for (int i = 3; i < argc; i += 2)
+    {
+        if (i + 1 == argc) usage();
+
+        const std::string_view option = argv[i];
+        const std::string      value  = argv[i + 1];
+        try
+        {
+            if      (option == "--seed")       options.seed       = std::stoull(value);
+            else if (option == "--lines")      options.lines      = std::stoul(value);
+            else if (option == "--breadth")    options.breadth    = std::stoul(value);
+            else if (option == "--depth")      options.depth      = std::stoul(value);
+            else if (option == "--blocks")     options.blocks     = std::stod(value);
+            else if (option == "--collisions") options.collisions = std::stod(value);
+            else if (option == "--length")
+            {
+                const auto comma = value.find(',');
+                options.meanLength = std::stoul(value.substr(0, comma));
+                options.maxLength  = comma == std::string::npos? options.meanLength * 3 : std::stoul(value.substr(comma + 1));
+            }
+            else usage();
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "Bad value for " << option << ": " << value << '\n';
+            Exit(EXIT_FAILURE);
+        }
+    }
+
+    std::error_code err;
+    if (fs::exists(destination, err) and !fs::is_empty(destination, err))
+    {
+        std::cerr << destination.string() << " already exists and isn't empty\n";
+        Exit(EXIT_FAILURE);
+    }
+    fs::create_directories(destination, err);
+
+    const auto start{std::chrono::steady_clock::now()};
+    const auto tree    = zkb::Generator::Generate(options);
+    const bool success = zkb::ProjectIO::CreateLines(tree, destination, 1);
+    const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+    std::cout << (success? "Generated " : "Partially generated ") << tree.nodes.size() << " lines in "
+        << elapsed.count() << "s\n";
+    if (!success) Exit(EXIT_FAILURE);
+}
+
+/**
+ * Reruns a session recorded with --record against a scratch copy of its snapshot.
+ * zkb replay session.log [--dir path] [--keep]
+ */
+void Application::Replay()
+{
+    if (argc < 3)
+    {
+        std::cerr << "Use: zkb replay session.log [--dir path] [--keep]\n";
+        Exit(EXIT_FAILURE);
+    }
+
+    zkb::Session::ReplayOptions options;
+    for (int i = 3; i < argc; i += 1)
+    {
+        const std::string_view option = argv[i];
+        if (option == "--keep")
+        {
+            options.keep = true;
+        }
+        else if (option == "--dir" and i + 1 < argc)
+        {
+            options.directory = fs::absolute(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Use: zkb replay session.log [--dir path] [--keep]\n";
+            Exit(EXIT_FAILURE);
+        }
+    }
+
+    Exit(zkb::Session::Replay(argv[2], options));
+}
+
+/**
+ * Serves the project of the current directory over a Unix socket.
+ * zkb daemon, "zkb daemon stop" or "zkb do q" stops it
+ */
+void Application::Daemon()
+{
+    if (argc == 3 and std::string_view(argv[2]) == "stop")
+    {
+        Exit(zkb::Daemon::Send("q"));
+    }
+
+    Exit(zkb::Daemon::Serve());
+}
+
+/**
+ * Runs one tooling command in the running daemon.
+ * zkb do command args...
+ */
+void Application::Send()
+{
+    if (argc < 3)
+    {
+        std::cerr << "Use: zkb do command args...\n";
+        Exit(EXIT_FAILURE);
+    }
+
+    std::string command = argv[2];
+    for (int i = 3; i < argc; i += 1)
+    {
+        command += ' ';
+        command += argv[i];
+    }
+
+    Exit(zkb::Daemon::Send(command));
+}
+
 /**
  * test
  * @param str String stuff
@@ -1,12 +1,17 @@
+#include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <string_view>
 
 #include "Utils.hpp"
 
 bool
 zkb::IsInteger(const std::string& str)
 {
-    for (const unsigned char& ch : str)
+    for (const unsigned char ch : str)
     {
         if (!std::isdigit(ch)) return false;
     }
@@ -34,3 +39,89 @@ zkb::Sign(int num)
     if (num == 0) return 0;
     return num > 0? 1 : -1;
 }
+
+std::string
+zkb::JsonEscape(std::string_view string)
+{
+    std::string out;
+    out.reserve(string.size());
+
+    for (const unsigned char ch : string)
+    {
+        switch (ch)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            case '\r': out += "\\r";  break;
+            default:
+            {
+                if (ch < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                    out += escaped;
+                }
+                else
+                {
+                    out += ch;
+                }
+            } break;
+        }
+    }
+    return out;
+}
+
+const char*
+zkb::JsonUnescape(const char* text, std::string& out)
+{
+    out.clear();
+    for (; *text != '"'; text += 1)
+    {
+        if (*text == '\0') return nullptr;
+        if (*text != '\\')
+        {
+            out += *text;
+            continue;
+        }
+
+        text += 1;
+        switch (*text)
+        {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'n':  out += '\n'; break;
+            case 't':  out += '\t'; break;
+            case 'r':  out += '\r'; break;
+            case 'u':
+            {
+                char* end;
+                const std::string hex(text + 1, std::min<std::size_t>(std::strlen(text + 1), 4));
+                const unsigned long codePoint = std::strtoul(hex.c_str(), &end, 16);
+                if (hex.size() != 4 or *end != '\0') return nullptr;
+
+                //UTF-8, the escapes JsonEscape writes are all below 0x80
+                if (codePoint < 0x80)
+                {
+                    out += static_cast<char>(codePoint);
+                }
+                else if (codePoint < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (codePoint >> 6));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xE0 | (codePoint >> 12));
+                    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+                text += 4;
+            } break;
+            default: return nullptr;
+        }
+    }
+    return text + 1;
+}
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Baseline.hpp"
+#include "Utils.hpp"
+
+namespace fs = zkb::Bench::fs;
+using Result = zkb::Bench::Result;
+
+#ifndef ZKB_BENCH_BASELINES
+#define ZKB_BENCH_BASELINES "baselines"
+#endif
+
+namespace
+{
+    //Value after the first "key": from text on, in one of the lines Save writes
+    const char* After(const char* text, std::string_view key)
+    {
+        if (text == nullptr) return nullptr;
+
+        const auto at = std::string_view(text).find(key);
+        if (at == std::string_view::npos) return nullptr;
+        return text + at + key.size();
+    }
+
+    //Numbers of a "[1,2,3]" list starting at text, nullptr if it isn't closed
+    template <typename T>
+    const char* ReadList(const char* text, T& out)
+    {
+        if (text == nullptr or *text != '[') return nullptr;
+        text += 1;
+
+        while (*text != ']')
+        {
+            char* end;
+            const double value = std::strtod(text, &end);
+            if (end == text) return nullptr;
+            out.push_back(static_cast<typename T::value_type>(value));
+
+            text = end;
+            if (*text == ',') text += 1;
+        }
+        return text + 1;
+    }
+
+    /*
+     * Probability of current being this much slower than baseline by chance:
+     * Mann-Whitney U with the normal approximation and a tie correction.
+     * Doesn't assume latencies are normally distributed, they rarely are.
+     */
+    double SlowerPValue(const std::vector<double>& baseline, const std::vector<double>& current)
+    {
+        const double n1 = baseline.size();
+        const double n2 = current.size();
+        if (n1 == 0 or n2 == 0) return 1;
+
+        struct Sample
+        {
+            double value;
+            bool   isCurrent;
+        };
+
+        std::vector<Sample> all;
+        all.reserve(baseline.size() + current.size());
+        for (const double value : baseline) all.push_back({value, false});
+        for (const double value : current)  all.push_back({value, true});
+        std::sort(all.begin(), all.end(), [](const Sample& a, const Sample& b) { return a.value < b.value; });
+
+        //Average ranks over ties
+        double currentRanks = 0;
+        double ties         = 0;
+        for (std::size_t i = 0; i < all.size();)
+        {
+            std::size_t j = i;
+            while (j < all.size() and all[j].value == all[i].value) j += 1;
+
+            const double rank  = (i + 1 + j) / 2.0;
+            const double count = j - i;
+            for (std::size_t k = i; k < j; k += 1)
+            {
+                if (all[k].isCurrent) currentRanks += rank;
+            }
+            ties += count * count * count - count;
+            i = j;
+        }
+
+        const double u        = currentRanks - n2 * (n2 + 1) / 2;
+        const double n        = n1 + n2;
+        const double mean     = n1 * n2 / 2;
+        const double variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+        if (variance <= 0) return 1;
+
+        //Continuity corrected, upper tail
+        const double z = (u - mean - 0.5) / std::sqrt(variance);
+        return 0.5 * std::erfc(z / std::sqrt(2.0));
+    }
+
+    //Median absolute deviation relative to the median, the noise of one measure
+    double RelativeSpread(const Result& result)
+    {
+        const double median = result.Median();
+        if (median <= 0) return 0;
+
+        Result deviations;
+        deviations.samples.reserve(result.samples.size());
+        for (const double sample : result.samples) deviations.samples.push_back(std::abs(sample - median));
+        return deviations.Median() / median;
+    }
+}
+
+fs::path
+zkb::Bench::Baseline::FilePath(std::string_view name)
+{
+    return fs::path(ZKB_BENCH_BASELINES) / (std::string(name) + ".json");
+}
+
+bool
+zkb::Bench::Baseline::Save(std::string_view name, const std::vector<Result>& results)
+{
+    const auto path = FilePath(name);
+
+    std::error_code err;
+    fs::create_directories(path.parent_path(), err);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Can't write baseline " << path.string() << '\n';
+        return false;
+    }
+
+    //One result per line, Load relies on it
+    std::string out = "{\"version\":1,\"results\":[\n";
+    char number[32];
+    for (std::size_t i = 0; i < results.size(); i += 1)
+    {
+        const auto& result = results[i];
+        out += "{\"command\":\"" + zkb::JsonEscape(result.command) + "\",\"lines\":" + std::to_string(result.lines) +
+               ",\"depth\":" + std::to_string(result.depth) +
+               ",\"directory\":\"" + zkb::JsonEscape(result.directory.string()) +
+               "\",\"filesystem\":\"" + zkb::JsonEscape(result.filesystem) + "\",\"samples\":[";
+        for (std::size_t j = 0; j < result.samples.size(); j += 1)
+        {
+            std::snprintf(number, sizeof(number), "%s%.3f", j == 0? "" : ",", result.samples[j]);
+            out += number;
+        }
+        out += "],\"syscalls\":[";
+        for (std::size_t j = 0; j < result.syscalls.counts.size(); j += 1)
+        {
+            if (j != 0) out += ',';
+            out += std::to_string(result.syscalls.counts[j]);
+        }
+        out += i + 1 == results.size()? "]}\n" : "]},\n";
+    }
+    out += "]}\n";
+
+    file.write(out.data(), out.size());
+    if (!file)
+    {
+        std::cerr << "Can't write baseline " << path.string() << '\n';
+        return false;
+    }
+
+    std::cout << "Saved baseline " << path.string() << '\n';
+    return true;
+}
+
+std::optional<std::vector<Result>>
+zkb::Bench::Baseline::Load(std::string_view name)
+{
+    const auto path = FilePath(name);
+
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "No baseline " << path.string() << '\n';
+        return std::nullopt;
+    }
+
+    std::vector<Result> results;
+    for (std::string line; std::getline(file, line);)
+    {
+        const char* command = After(line.c_str(), "{\"command\":\"");
+        if (command == nullptr) continue;
+
+        Result      result{};
+        std::string directory;
+        std::vector<uint64_t> syscalls;
+
+        //Keys in the order Save writes them, each searched after the previous value
+        const char* text  = zkb::JsonUnescape(command, result.command);
+        const char* lines = After(text, "\"lines\":");
+        const char* depth = After(lines, "\"depth\":");
+
+        text = After(depth, "\"directory\":\"");
+        text = text != nullptr? zkb::JsonUnescape(text, directory)         : nullptr;
+        text = After(text, "\"filesystem\":\"");
+        text = text != nullptr? zkb::JsonUnescape(text, result.filesystem) : nullptr;
+        text = ReadList(After(text, "\"samples\":"), result.samples);
+        text = ReadList(After(text, "\"syscalls\":"), syscalls);
+        if (text == nullptr)
+        {
+            std::cerr << "Malformed baseline " << path.string() << '\n';
+            return std::nullopt;
+        }
+        result.lines     = std::strtoul(lines, nullptr, 10);
+        result.depth     = std::strtoul(depth, nullptr, 10);
+        result.directory = std::move(directory);
+        std::copy_n(syscalls.begin(), std::min(syscalls.size(), result.syscalls.counts.size()), result.syscalls.counts.begin());
+
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+bool
+zkb::Bench::Baseline::Compare(const std::vector<Result>& baseline, const std::vector<Result>& current,
+    const CompareOptions& options, std::ostream& out)
+{
+    char row[512];
+    std::snprintf(row, sizeof(row), "%-10s %5s %-8s %9s %13s %13s %9s %8s %8s  %-10s  %s\n",
+        "fs", "depth", "command", "lines", "base_med_us", "new_med_us", "change", "noise", "p", "verdict", "directory");
+    out << row;
+
+    uint32_t                   regressions = 0;
+    std::vector<const Result*> unmatched;
+    for (const auto& result : current)
+    {
+        const auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& other)
+        {
+            return other.command == result.command and other.lines == result.lines and
+                   other.depth == result.depth and other.filesystem == result.filesystem and
+                   other.directory == result.directory;
+        });
+        if (base == baseline.end())
+        {
+            unmatched.push_back(&result);
+            continue;
+        }
+
+        const double before = base->Median();
+        const double after  = result.Median();
+        const double change = before > 0? (after / before - 1) * 100 : 0;
+        const double noise  = std::max(RelativeSpread(*base), RelativeSpread(result)) * 100;
+        const double slower = SlowerPValue(base->samples, result.samples);
+        const double faster = SlowerPValue(result.samples, base->samples);
+
+        //Both the size of the change and its significance, a noisy 10% isn't a regression
+        const char* verdict = "same";
+        if (change > options.threshold and slower < options.alpha)
+        {
+            verdict = "REGRESSION";
+            regressions += 1;
+        }
+        else if (change < -options.threshold and faster < options.alpha) verdict = "faster";
+        else if (std::abs(change) > options.threshold)                   verdict = "noise";
+
+        std::snprintf(row, sizeof(row), "%-10s %5u %-8s %9u %13.1f %13.1f %8.1f%% %7.1f%% %8.4f  %-10s  %s\n",
+            result.filesystem.c_str(), result.depth, result.command.c_str(), result.lines, before, after,
+            change, noise, change > 0? slower : faster, verdict, result.directory.c_str());
+        out << row;
+    }
+
+    const std::size_t matched = current.size() - unmatched.size();
+    out << matched << " of " << current.size() << " result(s) compared\n";
+
+    if (!unmatched.empty())
+    {
+        out << "No baseline for:\n";
+        for (const auto* result : unmatched)
+        {
+            std::snprintf(row, sizeof(row), "%-10s %5u %-8s %9u  %s\n",
+                result->filesystem.c_str(), result->depth, result->command.c_str(), result->lines,
+                result->directory.c_str());
+            out << row;
+        }
+    }
+
+    if (regressions != 0)
+    {
+        out << regressions << " median(s) regressed by more than " << options.threshold << "%\n";
+    }
+
+    //A run that shares nothing with the baseline proves nothing, it mustn't pass silently
+    if (matched == 0)
+    {
+        out << "Nothing matched the baseline\n";
+        return false;
+    }
+    return regressions == 0;
+}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include "Bench.hpp"
+#include "BlockListing.hpp"
+#include "CommandHandler.hpp"
+#include "Directory.hpp"
+
+namespace fs = zkb::Bench::fs;
+using Result   = zkb::Bench::Result;
+using Syscalls = zkb::Bench::Syscalls;
+
+namespace
+{
+    //Untimed commands keep the block at the same size between iterations
+    struct Step
+    {
+        const char* command;
+        //Formatted with the middle line (1$), the one after (2$) and the run (3$)
+        const char* format;
+        bool        timed;
+    };
+
+    //Texts are unique per run so "s" never swaps two lines of the same text, which is a no-op
+    constexpr std::array steps
+    {
+        Step{"l",    "l bench %1$u",              true},
+        Step{"c",    "c changed_%3$u %1$u",       true},
+        Step{"s",    "s %1$u %2$u",               true},
+        Step{"ls",   "ls",                        true},
+        Step{"cd",   "cd %1$u",                   true},
+        Step{"",     "cd ..",                     false},
+        Step{"d",    "d %1$u",                    true},
+        Step{"undo", "u",                         true},
+        Step{"",     "d %1$u",                    false},
+    };
+
+    //Lines "1 line 1" to "N line N" in block, straight syscalls so setup isn't part of the measure
+    bool CreateBlock(const fs::path& block, uint32_t lines)
+    {
+        if (mkdir(block.c_str(), 0755) != 0) return false;
+
+        const int fd = open(block.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return false;
+
+        char name[NAME_MAX + 1];
+        bool success = true;
+        for (uint32_t line = 1; line <= lines and success; line += 1)
+        {
+            std::snprintf(name, sizeof(name), "%u line %u", line, line);
+            success = mkdirat(fd, name, 0755) == 0;
+        }
+        close(fd);
+        return success;
+    }
+
+    //Lines "1 level" nested depth times under root, the innermost one is created by CreateBlock
+    fs::path CreateNesting(const fs::path& root, uint32_t depth)
+    {
+        fs::path block = root;
+        for (uint32_t level = 0; level < depth; level += 1)
+        {
+            if (mkdir(block.c_str(), 0755) != 0) return {};
+            block /= "1 level";
+        }
+        return block;
+    }
+
+    std::string FilesystemName(const fs::path& directory)
+    {
+        struct statfs st;
+        if (statfs(directory.c_str(), &st) != 0) return "unknown";
+
+        switch (static_cast<uint64_t>(st.f_type))
+        {
+            case 0xEF53:     return "ext4";
+            case 0x58465342: return "xfs";
+            case 0x01021994: return "tmpfs";
+            case 0x794C7630: return "overlayfs";
+            case 0x9123683E: return "btrfs";
+            case 0x2FC12FC1: return "zfs";
+            case 0x6969:     return "nfs";
+            case 0x65735546: return "fuse";
+        }
+
+        char hex[32];
+        std::snprintf(hex, sizeof(hex), "0x%llx", static_cast<unsigned long long>(st.f_type));
+        return hex;
+    }
+
+    //Output of the tooling is discarded, only its latency matters
+    struct Silence
+    {
+        std::ostringstream sink;
+        std::istringstream input;
+        std::streambuf*    out = std::cout.rdbuf(sink.rdbuf());
+        std::streambuf*    err = std::cerr.rdbuf(sink.rdbuf());
+        std::streambuf*    in  = std::cin.rdbuf(input.rdbuf());
+
+        ~Silence()
+        {
+            std::cout.rdbuf(out);
+            std::cerr.rdbuf(err);
+            std::cin.rdbuf(in);
+        }
+
+        void Clear()
+        {
+            sink.str({});
+            std::cin.clear();
+        }
+    };
+
+    void RunSize(const zkb::Bench::Options& options, const fs::path& directory, uint32_t depth, uint32_t lines,
+        std::vector<Result>& results)
+    {
+        const fs::path root = directory / "zkb_bench.zkb";
+        std::error_code err;
+        fs::remove_all(root, err);
+
+        const auto setupStart = std::chrono::steady_clock::now();
+        const fs::path block  = CreateNesting(root, depth);
+        if (block.empty() or !CreateBlock(block, lines))
+        {
+            std::cerr << "Can't create " << lines << " lines in " << root.string() << '\n';
+            fs::remove_all(root, err);
+            return;
+        }
+        const std::chrono::duration<double> setup{std::chrono::steady_clock::now() - setupStart};
+        std::cerr << "Created " << lines << " lines at depth " << depth << " in " << root.string()
+                  << " in " << setup.count() << "s\n";
+
+        const auto wanted = [&](const char* command)
+        {
+            return options.commands.empty() or
+                std::find(options.commands.begin(), options.commands.end(), command) != options.commands.end();
+        };
+
+        const std::size_t first = results.size();
+        for (const auto& step : steps)
+        {
+            if (step.timed and wanted(step.command))
+            {
+                results.push_back({step.command, lines, depth, directory, FilesystemName(directory), {}, {}});
+            }
+        }
+
+        const auto previous = fs::current_path();
+        fs::current_path(block);
+        CommandHandler::rootPath  = root;
+        CommandHandler::basedPath = block;
+        zkb::Directory::updateNumberOfDirs = true;
+        zkb::BlockListing::Invalidate();
+
+        {
+            Silence silence;
+            CommandHandler handler(false);
+            handler.showPrompt = false;
+
+            const uint32_t middle = std::max(1u, lines / 2);
+            const auto     start  = std::chrono::steady_clock::now();
+
+            char command[64];
+            for (uint32_t run = 0; run < options.runs; run += 1)
+            {
+                const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+                if (run >= 3 and elapsed.count() > options.budget) break;
+
+                std::size_t result = first;
+                for (const auto& step : steps)
+                {
+                    std::snprintf(command, sizeof(command), step.format, middle, middle + 1, run);
+
+                    const bool measured    = step.timed and wanted(step.command);
+                    const auto syscallsIn  = Syscalls::Now();
+                    const auto commandIn   = std::chrono::steady_clock::now();
+                    handler.Execute(command);
+                    const auto commandOut  = std::chrono::steady_clock::now();
+                    const auto syscallsOut = Syscalls::Now();
+                    silence.Clear();
+
+                    if (!measured) continue;
+
+                    auto& out = results[result++];
+                    out.samples.push_back(std::chrono::duration<double, std::micro>{commandOut - commandIn}.count());
+                    for (uint32_t kind = 0; kind < Syscalls::COUNT; kind += 1)
+                    {
+                        out.syscalls.counts[kind] += (syscallsOut - syscallsIn).counts[kind];
+                    }
+                }
+            }
+        }
+
+        fs::current_path(previous);
+        fs::remove_all(root, err);
+    }
+}
+
+double
+Result::Percentile(double p) const
+{
+    if (samples.empty()) return 0;
+
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    const auto rank = static_cast<std::size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+double
+Result::Median() const
+{
+    return Percentile(50);
+}
+
+double
+Result::Mean() const
+{
+    if (samples.empty()) return 0;
+    return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+const std::vector<std::string>&
+zkb::Bench::Commands()
+{
+    static const std::vector<std::string> commands = []()
+    {
+        std::vector<std::string> out;
+        for (const auto& step : steps)
+        {
+            if (step.timed) out.emplace_back(step.command);
+        }
+        return out;
+    }();
+    return commands;
+}
+
+std::vector<Result>
+zkb::Bench::Run(const Options& options)
+{
+    std::vector<Result> results;
+    for (const auto& directory : options.directories)
+    {
+        for (const uint32_t depth : options.depths)
+        {
+            for (const uint32_t lines : options.sizes)
+            {
+                RunSize(options, directory, depth, lines, results);
+            }
+        }
+    }
+    return results;
+}
+
+void
+zkb::Bench::Print(const std::vector<Result>& results, std::ostream& out)
+{
+    char row[256];
+    std::snprintf(row, sizeof(row), "%-10s %5s %-8s %9s %5s %11s %11s %11s %11s %10s %9s",
+        "fs", "depth", "command", "lines", "runs", "median_us", "p90_us", "p99_us", "max_us", "ops/s", "sys/op");
+    out << row;
+    for (const auto& name : Syscalls::names)
+    {
+        std::snprintf(row, sizeof(row), " %8.*s", static_cast<int>(name.size()), name.data());
+        out << row;
+    }
+    out << '\n';
+
+    for (const auto& result : results)
+    {
+        const double runs = std::max<std::size_t>(result.samples.size(), 1);
+        const double mean = result.Mean();
+
+        std::snprintf(row, sizeof(row), "%-10s %5u %-8s %9u %5zu %11.1f %11.1f %11.1f %11.1f %10.1f %9.1f",
+            result.filesystem.c_str(), result.depth, result.command.c_str(), result.lines, result.samples.size(),
+            result.Median(), result.Percentile(90), result.Percentile(99), result.Percentile(100),
+            mean > 0? 1e6 / mean : 0.0, result.syscalls.Total() / runs);
+        out << row;
+
+        for (const auto count : result.syscalls.counts)
+        {
+            std::snprintf(row, sizeof(row), " %8.1f", count / runs);
+            out << row;
+        }
+        out << '\n';
+    }
+}
+
+void
+zkb::Bench::WriteCsv(const std::vector<Result>& results, std::ostream& out)
+{
+    out << "directory,filesystem,depth,lines,command,runs,median_us,p90_us,p99_us,max_us,ops_per_s,scaling";
+    for (const auto& name : Syscalls::names) out << ',' << name << "_per_op";
+    out << '\n';
+
+    char row[256];
+    for (const auto& result : results)
+    {
+        //Same series at the closest smaller size
+        const Result* previous = nullptr;
+        for (const auto& other : results)
+        {
+            if (other.command == result.command and other.depth == result.depth and
+                other.directory == result.directory and other.lines < result.lines and
+                (previous == nullptr or other.lines > previous->lines))
+            {
+                previous = &other;
+            }
+        }
+
+        std::string scaling;
+        if (previous != nullptr and previous->Median() > 0 and result.Median() > 0)
+        {
+            const double exponent = std::log(result.Median() / previous->Median()) /
+                                    std::log(static_cast<double>(result.lines) / previous->lines);
+            std::snprintf(row, sizeof(row), "%.3f", exponent);
+            scaling = row;
+        }
+
+        const double runs = std::max<std::size_t>(result.samples.size(), 1);
+        const double mean = result.Mean();
+
+        //Directories are quoted, they may contain commas
+        std::string directory = result.directory.string();
+        for (std::size_t at = directory.find('"'); at != std::string::npos; at = directory.find('"', at + 2))
+        {
+            directory.insert(at, 1, '"');
+        }
+
+        std::snprintf(row, sizeof(row), ",%s,%u,%u,%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%s",
+            result.filesystem.c_str(), result.depth, result.lines, result.command.c_str(), result.samples.size(),
+            result.Median(), result.Percentile(90), result.Percentile(99), result.Percentile(100),
+            mean > 0? 1e6 / mean : 0.0, scaling.c_str());
+        out << '"' << directory << '"' << row;
+
+        for (const auto count : result.syscalls.counts)
+        {
+            std::snprintf(row, sizeof(row), ",%.1f", count / runs);
+            out << row;
+        }
+        out << '\n';
+    }
+}
@@ -0,0 +1,199 @@
+#include <atomic>
+#include <cstdarg>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Syscalls.hpp"
+
+using Syscalls = zkb::Bench::Syscalls;
+
+namespace
+{
+    std::atomic<uint64_t> counters[Syscalls::COUNT];
+
+    void Count(Syscalls::Kind kind)
+    {
+        counters[kind].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //Next definition of name after this executable, libc's
+    template <typename FunctionT>
+    FunctionT Real(FunctionT, const char* name)
+    {
+        return reinterpret_cast<FunctionT>(dlsym(RTLD_NEXT, name));
+    }
+}
+
+#define ZKB_REAL(name) static const auto real = Real(&::name, #name)
+
+extern "C"
+{
+    DIR* opendir(const char* path)
+    {
+        ZKB_REAL(opendir);
+        Count(Syscalls::Scan);
+        return real(path);
+    }
+
+    dirent* readdir(DIR* dir)
+    {
+        ZKB_REAL(readdir);
+        Count(Syscalls::Entry);
+        return real(dir);
+    }
+
+    int stat(const char* path, struct stat* st) noexcept
+    {
+        ZKB_REAL(stat);
+        Count(Syscalls::Stat);
+        return real(path, st);
+    }
+
+    int lstat(const char* path, struct stat* st) noexcept
+    {
+        ZKB_REAL(lstat);
+        Count(Syscalls::Stat);
+        return real(path, st);
+    }
+
+    int fstatat(int dirfd, const char* path, struct stat* st, int flags) noexcept
+    {
+        ZKB_REAL(fstatat);
+        Count(Syscalls::Stat);
+        return real(dirfd, path, st, flags);
+    }
+
+    int open(const char* path, int flags, ...)
+    {
+        ZKB_REAL(open);
+        Count(Syscalls::Open);
+
+        mode_t mode = 0;
+        if (flags & (O_CREAT | O_TMPFILE))
+        {
+            va_list args;
+            va_start(args, flags);
+            mode = va_arg(args, mode_t);
+            va_end(args);
+        }
+        return real(path, flags, mode);
+    }
+
+    int openat(int dirfd, const char* path, int flags, ...)
+    {
+        ZKB_REAL(openat);
+        Count(Syscalls::Open);
+
+        mode_t mode = 0;
+        if (flags & (O_CREAT | O_TMPFILE))
+        {
+            va_list args;
+            va_start(args, flags);
+            mode = va_arg(args, mode_t);
+            va_end(args);
+        }
+        return real(dirfd, path, flags, mode);
+    }
+
+    int mkdir(const char* path, mode_t mode) noexcept
+    {
+        ZKB_REAL(mkdir);
+        Count(Syscalls::Mkdir);
+        return real(path, mode);
+    }
+
+    int mkdirat(int dirfd, const char* path, mode_t mode) noexcept
+    {
+        ZKB_REAL(mkdirat);
+        Count(Syscalls::Mkdir);
+        return real(dirfd, path, mode);
+    }
+
+    int rename(const char* from, const char* to) noexcept
+    {
+        ZKB_REAL(rename);
+        Count(Syscalls::Rename);
+        return real(from, to);
+    }
+
+    int renameat(int fromfd, const char* from, int tofd, const char* to) noexcept
+    {
+        ZKB_REAL(renameat);
+        Count(Syscalls::Rename);
+        return real(fromfd, from, tofd, to);
+    }
+
+    int unlink(const char* path) noexcept
+    {
+        ZKB_REAL(unlink);
+        Count(Syscalls::Remove);
+        return real(path);
+    }
+
+    int unlinkat(int dirfd, const char* path, int flags) noexcept
+    {
+        ZKB_REAL(unlinkat);
+        Count(Syscalls::Remove);
+        return real(dirfd, path, flags);
+    }
+
+    int rmdir(const char* path) noexcept
+    {
+        ZKB_REAL(rmdir);
+        Count(Syscalls::Remove);
+        return real(path);
+    }
+
+    //std::filesystem::remove goes through it, and libc's unlink/rmdir calls inside it aren't interposed
+    int remove(const char* path) noexcept
+    {
+        ZKB_REAL(remove);
+        Count(Syscalls::Remove);
+        return real(path);
+    }
+
+    int chdir(const char* path) noexcept
+    {
+        ZKB_REAL(chdir);
+        Count(Syscalls::Chdir);
+        return real(path);
+    }
+}
+
+Syscalls
+Syscalls::Now()
+{
+    Syscalls out;
+    for (uint32_t kind = 0; kind < COUNT; kind += 1)
+    {
+        out.counts[kind] = counters[kind].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+Syscalls
+Syscalls::operator-(const Syscalls& other) const
+{
+    Syscalls out;
+    for (uint32_t kind = 0; kind < COUNT; kind += 1)
+    {
+        out.counts[kind] = counts[kind] - other.counts[kind];
+    }
+    return out;
+}
+
+uint64_t
+Syscalls::Total() const
+{
+    uint64_t total = 0;
+    for (uint32_t kind = 0; kind < COUNT; kind += 1)
+    {
+        if (kind != Entry) total += counts[kind];
+    }
+    return total;
+}
@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Baseline.hpp"
+#include "Bench.hpp"
+
+namespace
+{
+    void Usage()
+    {
+        std::cerr <<
+            "Use: zkb_bench [options]\n"
+            "    --dir path         Where scratch projects are created (temp directory)\n"
+            "    --dirs a,b,...     Same for several directories, on the filesystems to compare\n"
+            "    --sizes 10,100,... Lines of the benchmarked block (10 to 1000000)\n"
+            "    --depths 0,8,...   Levels of nesting above the benchmarked block (0)\n"
+            "    --csv file         Also write every result and its scaling exponent as CSV, - for stdout\n"
+            "    --commands l,d,... Commands to time (l,c,s,ls,cd,d,undo)\n"
+            "    --runs #           Iterations per size (30)\n"
+            "    --budget seconds   Time per size before stopping early, 3 runs at least (10)\n"
+            "    --save-baseline $  Save the results as baseline $ in the build directory\n"
+            "    --compare $        Compare with baseline $, fails if a median regressed or nothing matched\n"
+            "    --threshold %      Median slowdown counted as a regression when significant (10)\n";
+    }
+
+    template <typename T>
+    std::vector<T> SplitList(std::string_view list)
+    {
+        std::vector<T> out;
+        std::stringstream stream{std::string(list)};
+        for (std::string item; std::getline(stream, item, ',');)
+        {
+            if (item.empty()) continue;
+            if constexpr (std::is_same_v<T, std::string>)                out.push_back(item);
+            else if constexpr (std::is_same_v<T, std::filesystem::path>) out.push_back(std::filesystem::absolute(item));
+            else                                                         out.push_back(std::stoul(item));
+        }
+        return out;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    zkb::Bench::Options                     options;
+    zkb::Bench::Baseline::CompareOptions    compareOptions;
+    std::string                             saveName;
+    std::string                             compareName;
+    std::string                             csvPath;
+
+    for (int i = 1; i < argc; i += 1)
+    {
+        const std::string_view option = argv[i];
+        if (i + 1 == argc)
+        {
+            Usage();
+            return EXIT_FAILURE;
+        }
+        const std::string_view value = argv[++i];
+
+        try
+        {
+            if      (option == "--dir")      options.directories = {std::filesystem::absolute(value)};
+            else if (option == "--dirs")     options.directories = SplitList<std::filesystem::path>(value);
+            else if (option == "--sizes")    options.sizes       = SplitList<uint32_t>(value);
+            else if (option == "--depths")   options.depths      = SplitList<uint32_t>(value);
+            else if (option == "--commands") options.commands    = SplitList<std::string>(value);
+            else if (option == "--runs")     options.runs        = std::stoul(std::string(value));
+            else if (option == "--budget")   options.budget      = std::stod(std::string(value));
+            else if (option == "--csv")      csvPath             = value;
+            else if (option == "--threshold") compareOptions.threshold = std::stod(std::string(value));
+            else if (option == "--save-baseline" and value.find('/') == std::string_view::npos) saveName    = value;
+            else if (option == "--compare"       and value.find('/') == std::string_view::npos) compareName = value;
+            else
+            {
+                Usage();
+                return EXIT_FAILURE;
+            }
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "Bad value for " << option << ": " << value << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    //Loaded first so a missing baseline doesn't cost a whole run
+    std::optional<std::vector<zkb::Bench::Result>> baseline;
+    if (!compareName.empty())
+    {
+        baseline = zkb::Bench::Baseline::Load(compareName);
+        if (!baseline) return EXIT_FAILURE;
+    }
+
+    const auto results = zkb::Bench::Run(options);
+    zkb::Bench::Print(results, std::cout);
+    if (results.empty()) return EXIT_FAILURE;
+
+    if (csvPath == "-")
+    {
+        zkb::Bench::WriteCsv(results, std::cout);
+    }
+    else if (!csvPath.empty())
+    {
+        std::ofstream csv(csvPath);
+        zkb::Bench::WriteCsv(results, csv);
+        if (!csv)
+        {
+            std::cerr << "Can't write " << csvPath << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!saveName.empty() and !zkb::Bench::Baseline::Save(saveName, results)) return EXIT_FAILURE;
+
+    if (baseline)
+    {
+        std::cout << "\nCompared with " << compareName << ":\n";
+        if (!zkb::Bench::Baseline::Compare(*baseline, results, compareOptions, std::cout)) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
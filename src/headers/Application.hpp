@@ -12,6 +12,12 @@ public:
     Application(char** argv, int argc);
 
     void Build();
+    void Import();
+    void Export();
+    void Generate();
+    void Replay();
+    void Daemon();
+    void Send();
 
     static void PrintHelp(const std::string_view);
     static void Exit(uint32_t errorCode = EXIT_SUCCESS);
@@ -13,6 +13,17 @@ namespace zkb
       -> std::string;
 
     int Sign(int);
+
+    //Contents of a JSON string literal, without the quotes
+    auto JsonEscape(std::string_view)
+      -> std::string;
+    /*
+     * Reverse of JsonEscape: reads the contents of a string literal starting after its
+     * opening quote into out. Returns the end of the literal, past the closing quote,
+     * or nullptr if it isn't closed or has a malformed escape.
+     */
+    auto JsonUnescape(const char* text, std::string& out)
+      -> const char*;
 }
 
 #endif
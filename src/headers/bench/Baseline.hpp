@@ -0,0 +1,46 @@
+#ifndef BASELINE_HPP
+#define BASELINE_HPP
+
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "Bench.hpp"
+
+namespace zkb::Bench
+{
+    /*
+     * Saved benchmark results, one JSON file per name in the build directory's
+     * "baselines" folder. Every sample is kept so a comparison can tell a slower
+     * command from a noisy one.
+     */
+    namespace Baseline
+    {
+        auto FilePath(std::string_view name)
+          -> fs::path;
+
+        bool Save(std::string_view name, const std::vector<Result>&);
+        auto Load(std::string_view name)
+          -> std::optional<std::vector<Result>>;
+
+        struct CompareOptions
+        {
+            //Slowdown of the median, in percent, that counts as a regression
+            double threshold = 10;
+            //One sided Mann-Whitney U significance level
+            double alpha     = 0.01;
+        };
+
+        /*
+         * Prints a table against the baseline and the results it has no match for.
+         * Returns false on a regression, or when no result matched the baseline.
+         */
+        auto Compare(const std::vector<Result>& baseline, const std::vector<Result>& current,
+            const CompareOptions&, std::ostream&)
+          -> bool;
+    }
+}
+
+#endif
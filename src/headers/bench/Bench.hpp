@@ -0,0 +1,71 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Syscalls.hpp"
+
+namespace zkb::Bench
+{
+    namespace fs = std::filesystem;
+
+    struct Options
+    {
+        //Scratch projects are created and removed inside each, one per filesystem to compare
+        std::vector<fs::path>    directories = {fs::temp_directory_path()};
+        //Lines of the benchmarked block
+        std::vector<uint32_t>    sizes       = {10, 100, 1'000, 10'000, 100'000, 1'000'000};
+        //Levels of nesting between the project root and the benchmarked block
+        std::vector<uint32_t>    depths      = {0};
+        //Commands to time, every one by default
+        std::vector<std::string> commands;
+        //Iterations per size, fewer if budget runs out first (3 at least)
+        uint32_t                 runs        = 30;
+        //Seconds per size
+        double                   budget      = 10;
+    };
+
+    struct Result
+    {
+        std::string         command;
+        uint32_t            lines;
+        uint32_t            depth;
+        fs::path            directory;
+        //Type of the filesystem of directory, "ext4", "tmpfs"...
+        std::string         filesystem;
+        //Microseconds, one per run
+        std::vector<double> samples;
+        //Sum over every run
+        Syscalls            syscalls;
+
+        //Nearest rank, p in [0, 100]
+        auto Percentile(double p) const
+          -> double;
+        auto Median() const
+          -> double;
+        auto Mean() const
+          -> double;
+    };
+
+    //Commands timed per iteration, in order
+    auto Commands()
+      -> const std::vector<std::string>&;
+
+    auto Run(const Options&)
+      -> std::vector<Result>;
+
+    //Aligned table, one row per command and size
+    void Print(const std::vector<Result>&, std::ostream&);
+    /*
+     * One row per directory, depth, size and command. scaling is the exponent of the
+     * median against the previous size of the same series, log(t2 / t1) / log(n2 / n1):
+     * about 0 while a command doesn't depend on the size of the block, 1 once it's linear.
+     */
+    void WriteCsv(const std::vector<Result>&, std::ostream&);
+}
+
+#endif
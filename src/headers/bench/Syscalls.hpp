@@ -0,0 +1,50 @@
+#ifndef SYSCALLS_HPP
+#define SYSCALLS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace zkb::Bench
+{
+    /*
+     * Filesystem calls made by the process, counted by wrappers that interpose the
+     * libc functions in zkb_bench (std::filesystem's calls included). Only linked in
+     * the benchmark, zkb itself calls libc directly.
+     */
+    struct Syscalls
+    {
+        enum Kind : uint32_t
+        {
+            Scan,    //opendir
+            Entry,   //readdir
+            Stat,    //stat, lstat, fstatat
+            Open,    //open, openat
+            Mkdir,   //mkdir, mkdirat
+            Rename,  //rename, renameat
+            Remove,  //unlink, unlinkat, rmdir, remove
+            Chdir,
+            COUNT
+        };
+
+        static constexpr std::array<std::string_view, COUNT> names
+        {
+            "scans", "entries", "stats", "opens", "mkdirs", "renames", "removes", "chdirs"
+        };
+
+        std::array<uint64_t, COUNT> counts{};
+
+        //Counters since the process started
+        static auto Now()
+          -> Syscalls;
+
+        auto operator-(const Syscalls&) const
+          -> Syscalls;
+
+        //Everything except readdir, which reads from a buffer most of the time
+        auto Total() const
+          -> uint64_t;
+    };
+}
+
+#endif
@@ -1,6 +0,0 @@
-#ifndef CMAKE_VARIABLES_H
-#define CMAKE_VARIABLES_H
-
-#define DEBUG_BUILD 1
-
-#endif
@@ -0,0 +1,129 @@
+#ifndef BLOCK_LISTING_HPP
+#define BLOCK_LISTING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CommandHandler.hpp"
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Lines of a block sorted by line number. Listings are cached per path and
+     * rebuilt when the block's mtime changes or the tooling edited the project
+     * (see Invalidate).
+     *
+     * Stored as parallel arrays: line numbers, offset and length of each filename
+     * in one shared buffer, and flags. Binary searches only touch the line
+     * numbers, and a listing allocates a handful of times whatever its size.
+     */
+    class BlockListing
+    {
+    public:
+        //View of one line, valid while the listing is
+        struct Line
+        {
+            uint32_t         lineNumber;
+            std::string_view filename;
+            bool             isBlock;
+
+            auto Name() const
+              -> std::string_view;
+        };
+
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = Line;
+            using difference_type   = std::ptrdiff_t;
+
+            Iterator() = default;
+            Iterator(const BlockListing* listing, std::size_t index) :
+                listing(listing), index(index)
+            {}
+
+            auto operator*() const
+              -> Line
+            {
+                return (*listing)[index];
+            }
+            auto operator++()
+              -> Iterator&
+            {
+                index += 1;
+                return *this;
+            }
+            auto operator++(int)
+              -> Iterator
+            {
+                auto previous = *this;
+                index += 1;
+                return previous;
+            }
+            bool operator==(const Iterator&) const = default;
+
+        private:
+            const BlockListing* listing = nullptr;
+            std::size_t         index   = 0;
+        };
+
+    public:
+        explicit BlockListing(const fs::path&);
+
+        static auto Get(const fs::path& = CommandHandler::basedPath)
+          -> std::shared_ptr<const BlockListing>;
+
+        //Marks every cached listing as stale, called after the tooling edits lines
+        static void Invalidate();
+
+    public:
+        auto operator[](std::size_t index) const
+          -> Line;
+        auto begin() const
+          -> Iterator;
+        auto end() const
+          -> Iterator;
+
+        auto Size() const
+          -> uint32_t;
+        bool Empty() const;
+
+        //Binary search, nullopt if the line doesn't exist
+        auto Find(uint32_t lineNumber) const
+          -> std::optional<Line>;
+        //First line whose text is name, nullopt if there is none
+        auto FindName(std::string_view name) const
+          -> std::optional<Line>;
+        //Index of the first line with lineNumber >= the argument
+        auto LowerBound(uint32_t lineNumber) const
+          -> std::size_t;
+
+    private:
+        enum Flags : uint8_t
+        {
+            IS_BLOCK = 1 << 0,
+        };
+
+        std::vector<uint32_t> lineNumbers;
+        std::vector<uint32_t> offsets;
+        std::vector<uint16_t> lengths;
+        std::vector<uint8_t>  flags;
+        std::string           names;
+
+        timespec              modified{};
+        uint64_t              generation = 0;
+    };
+}
+
+#endif
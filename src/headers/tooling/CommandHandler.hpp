@@ -3,24 +3,37 @@
 
 #include <array>
 #include <cstdint>
-#include <functional>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <memory>
 
 #include "other/CMakeVariables.h"
 
 namespace zkb 
 {
     class Directory;
+    struct CommandTable;
+    struct LineView;
+
+    namespace ProjectIO
+    {
+        struct LineTree;
+    }
 }
 
 class CommandHandler
 {
+    friend struct zkb::CommandTable;
+
 public:
-    CommandHandler();
+    //Runs the interactive loop over std::cin unless interactive is false
+    explicit CommandHandler(bool interactive = true);
 
 public:
     static constexpr int MAX_ARGS = 24;
+    //Lines shown above and below the current line by "ls"
+    static constexpr uint32_t LIST_WINDOW = 10;
     using ArgvT = std::array<std::string, MAX_ARGS>;
     struct ArgT
     {
@@ -53,6 +66,21 @@ public:
         Redo,
         LS,
         CD,
+        Quit,
+        Status,
+        Info,
+        Help,
+        Refresh,
+        Clean,
+        Build,
+        Tree,
+        Find,
+        Index,
+        Yank,
+        Put,
+        Storage,
+        Stats,
+        Memory,
         None
     };
 
@@ -62,46 +90,84 @@ public:
     };
 
 public:
+    bool SetupRoot();
+    void Run();
+    //Splits and handles one command line, returns true on quit
+    bool Execute(std::string command);
+    //Execute, reported as one JSON record per command line
+    bool ExecuteJson(std::string command);
     bool Handle();
 
+    //Makes block the current block, keeps the current line if it already is
+    bool ChangeBlock(const std::filesystem::path& block);
+
     static void WrongUsage(Command, bool crash = false);
     static void WrongUsage(Setup, bool   crash = false);
 
 private:
     void ShowBasedPath();
+    //y/n question, always no when there's no prompt
+    bool Confirm(std::string_view question);
 public:
+    //Shows the prompt and asks y/n questions, off when std::cin only holds commands
+    bool showPrompt = true;
+    //Run writes one JSON line per command instead of the human formatted output
+    bool jsonOutput = false;
+
     static std::filesystem::path basedPath;
     static std::filesystem::path rootPath;
+    //Set by anything that stops the current command line on an error, cleared by Execute
+    static bool failed;
 
 private:
+    uint32_t OperandCount() const;
 
+    void HandleQuit();
     void HandleNewLine();
     void SetCurrentLine();
     void HandleLineDelete();
     void HandleLineChange();
     void HandleLineSwap();
+    void HandleYank();
+    void HandlePut();
     void HandleUndo();
     void HandleRedo();
 
     void ShowStatus();
     void GetDirInfo();
+    void ShowSubtreeStats(const std::filesystem::path& block);
     void ListCurrentDirectory();
+    void ShowTree();
+    void FindLines();
+    void HandleIndex();
+    void HandleStorage();
+    void ShowCounters();
+    void ShowMemory();
+    void ShowHelp();
 
     void ChangeDirectory();
+    void CleanCurrentDirectory();
 
     bool ParseStringText(std::string& textArg);
     bool ParseRange(std::string&, Command);
 
-    //For changing directories
-    bool ParsePath(const std::string&);
+    //For changing directories, resolves a line number path through the cached listings
+    bool ParsePath(const std::string&, std::filesystem::path& resolved);
 
-    void RangedDirectoryIteration(std::function<void(const std::filesystem::directory_entry&, uint32_t)>);
-    void GenericDirectoryIteration(std::function<void(zkb::Directory)>);
+    //func(const zkb::LineView&) for lines inside range.num
+    template <typename Func>
+    void RangedDirectoryIteration(Func&&);
+    //func(const zkb::LineView&) for every line of basedPath
+    template <typename Func>
+    void GenericDirectoryIteration(Func&&);
 
     void DebugRefresh();
 
+    //Drops cached state of blocks other sessions edited since the last command
+    void SyncSharedChanges();
+
 #if DEBUG_BUILD
-    void Benchmark(Command, const std::array<std::string, 4>&);
+    void DebugBuild();
 
 #endif
 private:
@@ -117,9 +183,15 @@ private:
 
     bool               isRanged;
     bool               forceCommand;
+    bool               quit        = false;
+    //Replaying a history entry, what it changes isn't saved for undo again
+    bool               undoing     = false;
     Command            lastCommand = Command::None;
 
     bool updateDirectoriesList = true;
+
+    //Lines copied by yank, with their subtrees
+    std::shared_ptr<const zkb::ProjectIO::LineTree> clipboard;
 };
 
 #endif
@@ -0,0 +1,247 @@
+#ifndef COMMAND_TABLE_HPP
+#define COMMAND_TABLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+#include "CommandHandler.hpp"
+#include "other/CMakeVariables.h"
+
+namespace zkb
+{
+    /*
+     * One row per tooling command. Dispatch, arity validation, WrongUsage messages
+     * and the "help" text are all derived from this table (see commands.txt for the
+     * long form of the same information).
+     */
+    struct CommandSpec
+    {
+        using Command  = CommandHandler::Command;
+        using HandlerT = void (CommandHandler::*)();
+
+        static constexpr uint32_t MAX_ALIASES = 3;
+        static constexpr uint32_t VARIADIC    = CommandHandler::MAX_ARGS;
+
+        Command                                    command;
+        std::array<std::string_view, MAX_ALIASES>  aliases;
+
+        //Number of operands after the command word, a quoted string counts as one
+        uint32_t minArgs;
+        uint32_t maxArgs;
+
+        //Repeatable commands run # times when prefixed by a number: "3 l"
+        bool     repeatable;
+        //Edits lines, cached block listings are invalidated after it runs
+        bool     mutates;
+        //nullptr means the command is known but not implemented
+        HandlerT handler;
+
+        //Used by WrongUsage: "Error <action>: Wrong usage"
+        std::string_view action;
+        std::string_view usage;
+    };
+
+    struct CommandTable
+    {
+        using Command = CommandHandler::Command;
+        using CH      = CommandHandler;
+
+        static constexpr std::array entries
+        {
+            CommandSpec{Command::Quit,    {"q", "quit", "exit"}, 0, 0, false, false, &CH::HandleQuit,
+                "quitting",
+                "Quit [q|quit|exit]\n"
+                "    q - Exit the tooling.\n"},
+            CommandSpec{Command::Line,    {"l", "line"},   0, 2, true,  true,  &CH::HandleNewLine,
+                "adding a line",
+                "New line [l|line]\n"
+                "    l     - New line with blank ('...') filename.\n"
+                "    l $   - New line with $ filename.\n"
+                "    l $ # - New line at # with $ filename.\n"},
+            CommandSpec{Command::SetLine, {"sl"},          0, 1, false, false, &CH::SetCurrentLine,
+                "setting current line",
+                "Set line [sl]\n"
+                "    sl   - Set current line to one past the number of lines.\n"
+                "    sl # - Set current line to #.\n"},
+            CommandSpec{Command::Delete,  {"d", "delete"}, 0, 1, true,  true,  &CH::HandleLineDelete,
+                "removing line(s)",
+                "Delete line [d|delete]\n"
+                "    d          - Delete current line.\n"
+                "    d #        - Delete line #.\n"
+                "    -d (1#,2#) - Delete range.\n"
+                "    -d args... - Force delete blocks of code.\n"},
+            CommandSpec{Command::Change,  {"c", "change"}, 1, 2, false, true,  &CH::HandleLineChange,
+                "changing line(s)",
+                "Change line [c|change]\n"
+                "    c $          - Change current line to $.\n"
+                "    c $ #        - Change line # text to $.\n"
+                "    c 1# 2#      - Change line 2# text to line 1# text.\n"
+                "    -c $ (1#,2#) - Change lines 1# - 2# text to $.\n"},
+            CommandSpec{Command::Move,    {"m", "move"},   0, CommandSpec::VARIADIC, false, true,  nullptr,
+                "moving line(s)",
+                "Move line [m|move]\n"
+                "    Not implemented.\n"},
+            CommandSpec{Command::Swap,    {"s", "swap"},   1, 2, false, true,  &CH::HandleLineSwap,
+                "swaping line(s)",
+                "Swap line [s|swap]\n"
+                "    s 1#          - Swap current line with 1#.\n"
+                "    s 1# 2#       - Swap line 1# with 2#.\n"
+                "    -s (1#,2#) 3# - Move range block to line 3#.\n"},
+            CommandSpec{Command::Yank,    {"y", "yank"},   0, 1, false, false, &CH::HandleYank,
+                "yanking line(s)",
+                "Yank line [y|yank]\n"
+                "    y         - Copy current line and its block.\n"
+                "    y #       - Copy line # and its block.\n"
+                "    y (1#,2#) - Copy lines 1# - 2# and their blocks.\n"},
+            CommandSpec{Command::Put,     {"p", "put"},    0, 1, true,  true,  &CH::HandlePut,
+                "putting line(s)",
+                "Put line [p|put]\n"
+                "    p   - Insert the yanked lines at the current line.\n"
+                "    p # - Insert the yanked lines at line #.\n"},
+            CommandSpec{Command::Undo,    {"u", "undo"},   0, 1, true,  true,  &CH::HandleUndo,
+                "undoing",
+                "Undo line [u|undo]\n"
+                "    u - Undo last change.\n"},
+            CommandSpec{Command::Redo,    {"r", "redo"},   0, 1, true,  true,  &CH::HandleRedo,
+                "redoing",
+                "Redo line [r|redo]\n"
+                "    r - Redo last change.\n"},
+            CommandSpec{Command::LS,      {"ls"},          0, 1, false, false, &CH::ListCurrentDirectory,
+                "listing line(s)",
+                "List command [ls]\n"
+                "    ls    - List lines around the current line in ascending order.\n"
+                "    ls -a - List every line in ascending order.\n"
+                "    -ls   - List every line in non-specifying order.\n"
+                "    ls #  - List line #.\n"
+                "    ls $  - List line with name $.\n"},
+            CommandSpec{Command::Tree,    {"tree"},        0, 1, false, false, &CH::ShowTree,
+                "listing tree",
+                "Tree [tree]\n"
+                "    tree   - List every line under the current block, indented by depth.\n"
+                "    tree # - List up to # levels deep.\n"},
+            CommandSpec{Command::Find,    {"find"},        1, 2, false, false, &CH::FindLines,
+                "finding lines",
+                "Find [find]\n"
+                "    find $    - List every line of the project containing $ as /line/number/path.\n"
+                "    find $ -r - Same, with $ as a regular expression.\n"},
+            CommandSpec{Command::Index,   {"index"},       0, 1, false, false, &CH::HandleIndex,
+                "indexing",
+                "Index [index]\n"
+                "    index       - Show the state of the project's trigram index.\n"
+                "    index build - Create or rebuild the index, find uses it from then on.\n"
+                "    index off   - Delete the index.\n"},
+            CommandSpec{Command::Storage, {"storage"},     0, 1, false, true,  &CH::HandleStorage,
+                "changing storage",
+                "Storage [storage]\n"
+                "    storage        - Show how the project stores lines.\n"
+                "    storage hybrid - Store lines without children as files, converts the project.\n"
+                "    storage dirs   - Store every line as a directory, converts the project.\n"},
+            CommandSpec{Command::CD,      {"cd"},          0, 1, false, false, &CH::ChangeDirectory,
+                "changing directory",
+                "Change directory [cd]\n"
+                "    cd       - Change current directory to the current line.\n"
+                "    cd #/#/# - Change current directory through lines, \"..\" goes one block back.\n"
+                "    cd /#/#  - Same, starting from the project root. \"cd /\" goes to the root.\n"
+                "    cd $     - Change current directory to the line with text $.\n"},
+            CommandSpec{Command::Status,  {"status"},      0, 1, false, false, &CH::ShowStatus,
+                "showing status",
+                "Status [status]\n"
+                "    status    - Show the number of lines in the current block.\n"
+                "    status -r - Also show lines, depth and largest blocks of everything under it.\n"},
+            CommandSpec{Command::Info,    {"info"},        1, 2, false, false, &CH::GetDirInfo,
+                "getting line info",
+                "Info [info]\n"
+                "    info #    - Show text and block info of line #.\n"
+                "    info -r # - Also show lines, depth and largest blocks under line #.\n"},
+            CommandSpec{Command::Stats,   {"stats"},       0, 1, false, false, &CH::ShowCounters,
+                "showing counters",
+                "Stats [stats]\n"
+                "    stats       - Show runs, latency and filesystem work of every command type used.\n"
+                "    stats reset - Zero the counters.\n"},
+            CommandSpec{Command::Memory,  {"memory"},      0, 0, false, false, &CH::ShowMemory,
+                "showing memory",
+                "Memory [memory]\n"
+                "    memory - Show live bytes and allocations of history, listings and parsing.\n"},
+            CommandSpec{Command::Help,    {"help", "h"},   0, 1, false, false, &CH::ShowHelp,
+                "showing help",
+                "Help [help|h]\n"
+                "    help   - Show every command.\n"
+                "    help $ - Show command $.\n"},
+            CommandSpec{Command::Refresh, {"ref"},         0, CommandSpec::VARIADIC, false, true,  &CH::DebugRefresh,
+                "refreshing",
+                ""},
+            CommandSpec{Command::Clean,   {"clean"},       0, 0, false, true,  &CH::CleanCurrentDirectory,
+                "cleaning",
+                ""},
+#if DEBUG_BUILD
+            CommandSpec{Command::Build,   {"b"},           0, CommandSpec::VARIADIC, false, true,  &CH::DebugBuild,
+                "building",
+                ""},
+#endif
+        };
+
+        static constexpr std::size_t NUMBER_OF_ALIASES = []()
+        {
+            std::size_t count = 0;
+            for (const auto& spec : entries)
+            {
+                for (const auto& alias : spec.aliases)
+                {
+                    count += !alias.empty();
+                }
+            }
+            return count;
+        }();
+
+        //Sorted (alias, entry index) pairs so lookups are a binary search
+        static constexpr auto aliases = []()
+        {
+            std::array<std::pair<std::string_view, uint32_t>, NUMBER_OF_ALIASES> out{};
+
+            std::size_t i = 0;
+            for (uint32_t entry = 0; entry < entries.size(); entry += 1)
+            {
+                for (const auto& alias : entries[entry].aliases)
+                {
+                    if (!alias.empty()) out[i++] = {alias, entry};
+                }
+            }
+
+            std::sort(out.begin(), out.end());
+            return out;
+        }();
+
+        static_assert(std::adjacent_find(aliases.begin(), aliases.end(),
+            [](const auto& a, const auto& b) { return a.first == b.first; }) == aliases.end(),
+            "Duplicated command alias");
+
+        static constexpr auto Find(std::string_view name)
+          -> const CommandSpec*
+        {
+            auto it = std::lower_bound(aliases.begin(), aliases.end(), name,
+                [](const auto& elem, std::string_view value) { return elem.first < value; });
+
+            if (it == aliases.end() or it->first != name) return nullptr;
+            return &entries[it->second];
+        }
+
+        static constexpr auto Find(Command command)
+          -> const CommandSpec*
+        {
+            for (const auto& spec : entries)
+            {
+                if (spec.command == command) return &spec;
+            }
+            return nullptr;
+        }
+    };
+
+    static_assert(CommandTable::Find("l")->command     == CommandHandler::Command::Line);
+    static_assert(CommandTable::Find("swap")->command  == CommandHandler::Command::Swap);
+    static_assert(CommandTable::Find("nothing")        == nullptr);
+}
+
+#endif
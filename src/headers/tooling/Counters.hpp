@@ -0,0 +1,88 @@
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "CommandHandler.hpp"
+
+namespace zkb
+{
+    /*
+     * Always-on counters of the filesystem work done by each command type, plus a
+     * latency histogram per command. Counts go to the command running when they
+     * happen, jobs of the thread pool included. Adding is one relaxed atomic
+     * increment, scans add their entries once at the end.
+     */
+    struct Counters
+    {
+        using Command = CommandHandler::Command;
+
+        enum Kind : uint32_t
+        {
+            Scans,
+            Entries,
+            Renames,
+            //Lines created, as directories or as leaf files
+            Mkdirs,
+            Removes,
+            COUNT
+        };
+
+        static constexpr std::array<std::string_view, COUNT> names
+        {
+            "scans", "entries", "renames", "mkdirs", "removes"
+        };
+
+        //Bucket 0 is under 1us, bucket i is [2^(i-1), 2^i) us, the last one everything above
+        static constexpr uint32_t LATENCY_BUCKETS = 32;
+        static constexpr uint32_t COMMANDS        = static_cast<uint32_t>(Command::None) + 1;
+
+        //Attributes counts to command while alive, then records its latency
+        class Scope
+        {
+        public:
+            explicit Scope(Command);
+            ~Scope();
+
+            Scope(const Scope&)            = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            uint32_t                              previous;
+            uint32_t                              command;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        static void Add(Kind kind, uint64_t amount = 1) noexcept;
+
+        static void Reset();
+        //One row per command that ran since the last reset
+        static auto Report()
+          -> std::string;
+
+    private:
+        struct PerCommand
+        {
+            std::array<std::atomic<uint64_t>, COUNT>           counts;
+            std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> latency;
+            std::atomic<uint64_t>                              runs;
+            std::atomic<uint64_t>                              micros;
+        };
+
+        static std::array<PerCommand, COMMANDS> table;
+        static std::atomic<uint32_t>            current;
+    };
+
+    inline void
+    Counters::Add(Kind kind, uint64_t amount) noexcept
+    {
+        table[current.load(std::memory_order_relaxed)].counts[kind].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <filesystem>
+#include <string>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Long running tooling session for a project. The daemon keeps one
+     * CommandHandler (listings, indexes, history, current line) alive and runs the
+     * command lines sent by clients over a Unix socket.
+     *
+     * Request:  client's working directory '\n' command line
+     * Response: everything the command printed, '\0', then "ok" or "error"
+     */
+    namespace Daemon
+    {
+        auto SocketPath(const fs::path& root)
+          -> fs::path;
+
+        //Blocks until a client sends "q"
+        int Serve();
+
+        //Sends one command line from the current directory and prints the response, fails if it couldn't run
+        int Send(const std::string& command);
+    }
+}
+
+#endif
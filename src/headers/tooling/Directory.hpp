@@ -2,16 +2,66 @@
 #define DIRECTORY_HPP
 
 #include "CommandHandler.hpp"
+#include <charconv>
 #include <cstdint>
+#include <cstring>
 #include <span>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <type_traits>
+
+#include <dirent.h>
 
 namespace zkb
 {
     namespace fs   = std::filesystem;
 
+    /*
+     * Non-owning view of one line of a block. The string views point into the
+     * scan buffer and are only valid inside the iteration callback.
+     */
+    struct LineView
+    {
+        uint32_t         lineNumber;
+        //Text after the line number, what GetDirectoryName returns
+        std::string_view name;
+        //Full entry name, null terminated
+        std::string_view filename;
+        //Handle of the block being iterated, for *at() syscalls
+        int              dirfd;
+        //Stays the same across renames
+        uint64_t         inode;
+        //False for a leaf line stored as an empty file (hybrid storage)
+        bool             isBlock;
+    };
+
+    /*
+     * Snapshot of the line names of a block, taken with a single readdir pass into
+     * a reused per-thread buffer. Renaming entries while iterating is safe. Each
+     * entry is stored as its inode, a directory flag and its null terminated name.
+     */
+    class BlockScan
+    {
+    public:
+        explicit BlockScan(const fs::path&);
+        ~BlockScan();
+
+        BlockScan(const BlockScan&)            = delete;
+        BlockScan& operator=(const BlockScan&) = delete;
+
+        auto Names() const
+          -> std::string_view;
+        auto Fd() const
+          -> int;
+        bool IsOpen() const;
+
+    private:
+        DIR*         handle = nullptr;
+        std::string* buffer = nullptr;
+    };
+
     class Directory
     {
     public:
@@ -70,6 +120,8 @@ namespace zkb
             -> fs::directory_entry;
 
         static void RecursivelyDelete(const fs::directory_entry&, bool save = true);
+        //Removes a line and its subtree without saving them for undo
+        static void RemoveSubtree(const fs::directory_entry&);
 
         static auto CreateDirectory(const std::string&, const fs::path& = fs::current_path())
             -> bool;
@@ -78,6 +130,41 @@ namespace zkb
 
         static auto PathIterator(fs::path = CommandHandler::basedPath)
             -> fs::directory_iterator;
+
+        /*
+         * Hybrid storage, opt-in per project with a ".hybrid" file in the root: lines
+         * without children are created as empty files and only become directories when
+         * they get a first child. Every command reads both forms.
+         */
+        static bool HybridStorage(const fs::path& root = CommandHandler::rootPath);
+        //Turns a leaf line file into a directory, true if line is a directory afterwards
+        static bool PromoteLine(const fs::path& line);
+        //Turns an empty line directory into a file, false if it has lines or isn't a directory
+        static bool DemoteLine(const fs::path& line);
+        //Converts every line under block to the given storage, returns the number converted
+        static auto ConvertStorage(const fs::path& block, bool hybrid)
+            -> uint32_t;
+
+        /*
+         * Calls func(const LineView&) for every line of the block at path. If func
+         * returns bool, returning false stops the iteration.
+         */
+        template <typename Func>
+        static void ForEachLine(Func&& func, const fs::path& path = CommandHandler::basedPath);
+        //Same over an existing scan, views stay valid for as long as the scan does
+        template <typename Func>
+        static void ForEachLine(Func&& func, const BlockScan&);
+
+        static bool ParseLine(std::string_view filename, LineView& out);
+
+        /*
+         * Adds offset to the line number of every line >= from of the block in one
+         * pass, ordered so no rename lands on a line that wasn't moved yet.
+         */
+        static bool ShiftLines(const fs::path& block, uint32_t from, int32_t offset);
+
+        static bool RenameLine(const LineView&, uint32_t lineNumber);
+        static bool RenameLine(const LineView&, uint32_t lineNumber, std::string_view name);
         
     public:
         static std::stack<CommandHandler::HistoryT> history;
@@ -85,6 +172,61 @@ namespace zkb
         static uint32_t numberOfDirs;
         static bool     updateNumberOfDirs;
     };
+
+    inline bool
+    Directory::ParseLine(std::string_view filename, LineView& out)
+    {
+        const auto space = filename.find(' ');
+        const auto digits = filename.substr(0, space);
+
+        auto [ptr, err] = std::from_chars(digits.data(), digits.data() + digits.size(), out.lineNumber);
+        if (err != std::errc{} or ptr != digits.data() + digits.size()) return false;
+
+        out.filename = filename;
+        out.name     = space == std::string_view::npos? filename : filename.substr(space + 1);
+        return true;
+    }
+
+    template <typename Func>
+    void
+    Directory::ForEachLine(Func&& func, const fs::path& path)
+    {
+        BlockScan scan(path);
+        ForEachLine(std::forward<Func>(func), scan);
+    }
+
+    template <typename Func>
+    void
+    Directory::ForEachLine(Func&& func, const BlockScan& scan)
+    {
+        if (!scan.IsOpen()) return;
+
+        LineView view{};
+        view.dirfd = scan.Fd();
+
+        std::string_view names = scan.Names();
+        while (!names.empty())
+        {
+            std::memcpy(&view.inode, names.data(), sizeof(view.inode));
+            view.isBlock = names[sizeof(view.inode)] != 0;
+            names.remove_prefix(sizeof(view.inode) + 1);
+
+            const auto end      = names.find('\0');
+            const auto filename = names.substr(0, end);
+            names.remove_prefix(end + 1);
+
+            if (!ParseLine(filename, view)) continue;
+
+            if constexpr (std::is_same_v<std::invoke_result_t<Func&, const LineView&>, bool>)
+            {
+                if (!func(static_cast<const LineView&>(view))) return;
+            }
+            else
+            {
+                func(static_cast<const LineView&>(view));
+            }
+        }
+    }
 }
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <cstdint>
+#include <filesystem>
+
+#include "ProjectIO.hpp"
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Synthetic projects for benchmarks and comparisons. The same options and seed
+     * always give the same tree, on any platform: random numbers come from
+     * std::mt19937_64 and are shaped here instead of by the standard distributions,
+     * whose output is implementation defined.
+     */
+    namespace Generator
+    {
+        struct Options
+        {
+            uint64_t seed       = 1;
+            //Total number of lines
+            uint32_t lines      = 1'000;
+            //Most lines a nested block gets, each gets 1 to breadth
+            uint32_t breadth    = 8;
+            //Most levels of nesting below the top level lines
+            uint32_t depth      = 4;
+            //Chance of a line having lines of its own
+            double   blocks     = 0.3;
+            //Line text length, roughly normal around mean and clamped to [1, maxLength]
+            uint32_t meanLength = 24;
+            uint32_t maxLength  = 80;
+            //Chance of a line repeating the text of the line before it in its block
+            double   collisions = 0.05;
+        };
+
+        //Top level lines are added until the total is reached, nested blocks are filled breadth first
+        auto Generate(const Options&)
+          -> ProjectIO::LineTree;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "other/CMakeVariables.h"
+
+namespace zkb
+{
+    /*
+     * Allocation accounting, compiled in with -DZKB_ALLOCATIONS=ON. The global
+     * operator new and delete are replaced by counting versions that prefix every
+     * block with its size and the subsystem active on the allocating thread, so a
+     * free is charged back to that subsystem whichever thread does it.
+     * Without the option a Scope is empty and nothing is counted.
+     */
+    struct Memory
+    {
+        static constexpr bool enabled = ALLOCATION_TRACKING;
+
+        enum Subsystem : uint32_t
+        {
+            Other,
+            //Undo entries
+            History,
+            //Cached block listings and scan buffers
+            Listings,
+            //Command line split into arguments
+            Parse,
+            COUNT
+        };
+
+        static constexpr std::array<std::string_view, COUNT> names
+        {
+            "other", "history", "listings", "parse"
+        };
+
+        struct Usage
+        {
+            uint64_t liveBytes;
+            uint64_t liveBlocks;
+            uint64_t allocations;
+            uint64_t peakBytes;
+        };
+
+        //Charges allocations of this thread to subsystem while alive
+        class Scope
+        {
+        public:
+            explicit Scope(Subsystem subsystem) :
+                previous(current)
+            {
+                if constexpr (enabled) current = subsystem;
+            }
+            ~Scope()
+            {
+                current = previous;
+            }
+
+            Scope(const Scope&)            = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Subsystem previous;
+        };
+
+        static auto Get(Subsystem)
+          -> Usage;
+        //One row per subsystem and the total
+        static auto Report()
+          -> std::string;
+
+        static inline thread_local Subsystem current = Other;
+    };
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PROJECT_IO_HPP
+#define PROJECT_IO_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Conversion between .zkb trees and indentation-structured plain text, one
+     * source line per line, children indented deeper than their parent.
+     */
+    namespace ProjectIO
+    {
+        /*
+         * Lines and their subtrees in preorder, children of node i are in (i, end).
+         * Line numbers of the top level nodes are 1, 2, ... and are offset when created.
+         */
+        struct LineTree
+        {
+            struct Node
+            {
+                uint32_t lineNumber;
+                uint32_t end;
+                uint32_t textOffset;
+                uint32_t textLength;
+            };
+
+            std::vector<Node> nodes;
+            //Line texts back to back
+            std::string       texts;
+
+            auto Text(const Node& node) const
+              -> std::string_view;
+            auto NumberOfTopLevelLines() const
+              -> uint32_t;
+        };
+
+        //Lines first to last of block with their subtrees, each line read as a separate job
+        auto ReadLines(const fs::path& block, uint32_t first, uint32_t last)
+          -> LineTree;
+
+        //Creates tree inside destination numbered from firstLineNumber, each top level line as a separate job
+        bool CreateLines(const LineTree& tree, const fs::path& destination, uint32_t firstLineNumber);
+
+        //Closest ancestor of path (or path itself) ending with .zkb, empty if none
+        auto FindRoot(const fs::path&)
+          -> fs::path;
+
+        //Appends the lines of file after the last line of the block at destination
+        bool Import(const fs::path& file, const fs::path& destination);
+        bool Import(std::istream& input, const fs::path& destination);
+
+        //Writes every line under source in line order, indented 4 spaces per level
+        bool Export(const fs::path& source, std::ostream& out);
+    }
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    namespace Search
+    {
+        struct Query
+        {
+            std::string pattern;
+            //ECMAScript regex instead of a plain substring
+            bool        regex = false;
+        };
+
+        struct Match
+        {
+            //Line numbers from the searched root, "2/1/3"
+            std::string linePath;
+            std::string text;
+        };
+
+        /*
+         * Every line under root whose text matches, in line order. Each line of
+         * root is searched as a separate job on the shared thread pool.
+         */
+        auto Find(const fs::path& root, const Query&)
+          -> std::vector<Match>;
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <filesystem>
+#include <string_view>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Session logs for reproducing slow sessions, written with --record file.log and
+     * rerun with "zkb replay file.log".
+     *
+     *     ZKBSESSION 1
+     *     root <path of the recorded project>
+     *     block <current block when recording started, relative to root>
+     *     hybrid 0|1
+     *     tree <bytes>
+     *     <the project exported as indented text>
+     *     commands
+     *     <one command line per line, as read by the tooling>
+     *
+     * The snapshot keeps texts and structure, line numbers are renumbered without
+     * gaps when replayed.
+     */
+    namespace Session
+    {
+        //Opens file, the snapshot is taken when the tooling starts
+        bool Record(const fs::path& file);
+        auto Recording()
+          -> bool;
+
+        //Writes the header and the snapshot of root
+        void Begin(const fs::path& root, const fs::path& block);
+        //Appends a command line, flushed so a crashing session still has it
+        void Log(std::string_view command);
+
+        struct ReplayOptions
+        {
+            //Scratch copies are created inside it
+            fs::path directory = fs::temp_directory_path();
+            //Leave the scratch copy for inspection
+            bool     keep      = false;
+        };
+
+        //Recreates the snapshot in a scratch copy and times every command, returns an exit code
+        int Replay(const fs::path& file, const ReplayOptions&);
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SHARED_PROJECT_HPP
+#define SHARED_PROJECT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Coordination between tooling sessions working on the same project, kept in
+     * a POSIX shared memory object named after the root.
+     *
+     * Writers take an exclusive flock on it for the whole of a mutating command,
+     * so renumbering renames from two sessions never interleave. When the lock is
+     * released the blocks the command edited are published as one batch in a ring
+     * guarded by a seqlock. Readers copy the ring without locking and retry if a
+     * writer published meanwhile, then drop their cached listings, stats and index
+     * entries for only those blocks instead of rescanning the project.
+     */
+    class SharedProject
+    {
+    public:
+        static constexpr uint32_t RING_SIZE   = 64;
+        static constexpr uint32_t MAX_PATH    = 246;
+
+        /*
+         * Held for the duration of a mutating command. Re-entrant, commands that run
+         * other commands nest locks: only the outermost one takes the flock, and
+         * publishes the blocks of every nested lock when released.
+         */
+        class WriteLock
+        {
+        public:
+            WriteLock(SharedProject&, fs::path block);
+            ~WriteLock();
+
+            WriteLock(const WriteLock&)            = delete;
+            WriteLock& operator=(const WriteLock&) = delete;
+
+        private:
+            SharedProject& project;
+            fs::path       block;
+        };
+
+    public:
+        explicit SharedProject(fs::path root);
+        ~SharedProject();
+
+        SharedProject(const SharedProject&)            = delete;
+        SharedProject& operator=(const SharedProject&) = delete;
+
+        //Shared state of the session's project, nullptr if shared memory is unavailable
+        static auto Active()
+          -> SharedProject*;
+        //Deletes the shared memory object of root, even if sessions are still attached
+        static void Remove(const fs::path& root);
+
+        auto IsOpen() const
+          -> bool;
+
+        /*
+         * Lets other sessions in while a WriteLock holder waits on its user. Resume
+         * takes the lock back and returns false if another session published meanwhile,
+         * what the command read of the project may be stale.
+         */
+        void Suspend();
+        auto Resume()
+          -> bool;
+
+        /*
+         * Blocks edited by other sessions since the last call, appended to changed.
+         * Returns false when more batches were published than the ring holds, the
+         * caller has to assume anything changed.
+         */
+        auto Changes(std::vector<fs::path>& changed)
+          -> bool;
+
+    private:
+        struct Slot
+        {
+            uint64_t generation;
+            //UINT16_MAX when the block path didn't fit, readers treat it as a ring overflow
+            uint16_t length;
+            char     path[MAX_PATH];
+        };
+
+        struct Shared
+        {
+            uint64_t              magic;
+            //Sessions using the object, the last one to detach unlinks it
+            uint32_t              attached;
+            //Odd while a writer is publishing
+            std::atomic<uint64_t> sequence;
+            std::atomic<uint64_t> generation;
+            Slot                  slots[RING_SIZE];
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "Seqlock needs address-free atomics");
+
+        void Publish(const fs::path& block);
+
+    private:
+        fs::path root;
+        int      fd     = -1;
+        Shared*  shared = nullptr;
+        uint64_t seen   = 0;
+
+        //Nesting depth of WriteLocks and the blocks they edited
+        uint32_t              lockDepth = 0;
+        std::vector<fs::path> pending;
+    };
+}
+
+#endif
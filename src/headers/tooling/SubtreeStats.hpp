@@ -0,0 +1,49 @@
+#ifndef SUBTREE_STATS_HPP
+#define SUBTREE_STATS_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Aggregates of every block under a line. Results are cached per block by
+     * inode, so renumbered lines keep theirs, and checked against the block's
+     * mtime before being reused. Edits by the tooling invalidate the edited block
+     * and its ancestors (see Invalidate).
+     */
+    struct SubtreeStats
+    {
+        static constexpr uint32_t LARGEST_BLOCKS = 5;
+
+        struct Block
+        {
+            uint32_t    lines;
+            //Line numbers from the block the stats are of, "." for itself
+            std::string linePath;
+        };
+
+        //Every line under the block, at any depth
+        uint64_t           lines    = 0;
+        //Levels of lines under the block, 0 when it has no lines
+        uint32_t           depth    = 0;
+        uint32_t           ownLines = 0;
+        //Blocks with the most direct lines, largest first
+        std::vector<Block> largest;
+
+        //Lines of the block are computed as separate jobs when not cached
+        static auto Of(const fs::path& block)
+          -> SubtreeStats;
+
+        //Drops the cached stats of block and of its ancestors up to root
+        static void Invalidate(const fs::path& block, const fs::path& root);
+        //Drops every cached stats
+        static void Invalidate();
+    };
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace zkb
+{
+    /*
+     * Fixed size pool of worker threads. Tasks must not block waiting on other
+     * tasks of the same pool.
+     */
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(uint32_t numberOfThreads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&)            = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        template <typename Func>
+        auto Submit(Func&& func)
+          -> std::future<std::invoke_result_t<std::decay_t<Func>&>>;
+
+        auto Size() const
+          -> uint32_t;
+
+        //Pool shared by the tooling commands, created on first use
+        static auto Shared()
+          -> ThreadPool&;
+
+    private:
+        void Run();
+
+    private:
+        std::vector<std::thread>          workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex                        mutex;
+        std::condition_variable           condition;
+        bool                              stopping = false;
+    };
+
+    template <typename Func>
+    auto
+    ThreadPool::Submit(Func&& func) -> std::future<std::invoke_result_t<std::decay_t<Func>&>>
+    {
+        using ResultT = std::invoke_result_t<std::decay_t<Func>&>;
+
+        auto task   = std::make_shared<std::packaged_task<ResultT()>>(std::forward<Func>(func));
+        auto future = task->get_future();
+        {
+            std::lock_guard lock(mutex);
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return future;
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Chrome trace event output (chrome://tracing, ui.perfetto.dev), enabled with
+     * --trace file.json. Spans are complete ("X") events; nested spans on the same
+     * thread show as a call tree. Disabled, a span costs one relaxed load.
+     */
+    class Trace
+    {
+    public:
+        class Span
+        {
+        public:
+            //name and category must outlive the span, they are usually literals
+            Span(std::string_view name, std::string_view category);
+            ~Span();
+
+            Span(const Span&)            = delete;
+            Span& operator=(const Span&) = delete;
+
+            //Shown in the event's args, only kept while tracing
+            void Arg(std::string_view key, uint64_t value);
+            void Arg(std::string_view key, std::string_view value);
+
+        private:
+            bool                                  active;
+            std::string_view                      name;
+            std::string_view                      category;
+            std::chrono::steady_clock::time_point start;
+            std::string                           args;
+        };
+
+        //Events are written to file until the process exits
+        static bool Start(const fs::path& file);
+        static void Stop();
+
+        static auto Enabled()
+          -> bool;
+
+    private:
+        static std::atomic<bool> enabled;
+    };
+
+    inline bool
+    Trace::Enabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+}
+
+#endif
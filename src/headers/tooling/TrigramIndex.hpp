@@ -0,0 +1,116 @@
+#ifndef TRIGRAM_INDEX_HPP
+#define TRIGRAM_INDEX_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Search.hpp"
+
+namespace zkb
+{
+    namespace fs = std::filesystem;
+
+    /*
+     * Optional on-disk index of every line's text under a project root, stored
+     * beside the root as "<root>.trigrams". Substring queries intersect trigram
+     * posting lists instead of walking the tree.
+     *
+     * Lines are tracked by inode so renames (line number shifts) keep their
+     * subtrees. The tooling refreshes the block it edited after every mutating
+     * command, external edits are found by comparing block mtimes when the
+     * index is loaded. Before every find only the root and its lines are
+     * compared, any of them changed falls back to comparing every block. Edits
+     * two or more blocks below the root that add no line to a top level block
+     * wait for the next load or fallback.
+     */
+    class TrigramIndex
+    {
+    public:
+        explicit TrigramIndex(fs::path root);
+
+        static auto FilePath(const fs::path& root)
+          -> fs::path;
+
+        //Index of the session's project, loaded on first use. nullptr if there is no index file
+        static auto Active()
+          -> TrigramIndex*;
+        //Builds, saves and activates an index for root
+        static auto Create(const fs::path& root)
+          -> TrigramIndex*;
+        //Deletes the index file and deactivates it
+        static void Remove(const fs::path& root);
+        //Flushes the active index if one was loaded
+        static void FlushActive();
+
+    public:
+        void Build();
+        bool Load();
+        bool Save();
+        //Saves only if something changed since the last save
+        void Flush();
+
+        //Reconciles the lines of block with the disk
+        void Refresh(const fs::path& block);
+        //Reconciles every block whose mtime changed since it was indexed
+        void CheckModified();
+        //CheckModified, if the root or one of its lines changed since it was indexed
+        void CheckTopLevel();
+
+        auto Find(const Search::Query&) const
+          -> std::vector<Search::Match>;
+
+        auto NumberOfLines() const
+          -> uint32_t;
+        auto Root() const
+          -> const fs::path&;
+
+    private:
+        struct Node
+        {
+            uint32_t    parent;
+            uint32_t    lineNumber;
+            uint64_t    inode;
+            timespec    modified;
+            std::string filename;
+            bool        alive;
+
+            auto Text() const
+              -> std::string_view;
+        };
+
+        static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+        auto AddNode(uint32_t parent, uint32_t lineNumber, uint64_t inode, std::string filename)
+          -> uint32_t;
+        void IndexText(uint32_t node);
+        void Reconcile(uint32_t node, const fs::path&);
+        void Kill(uint32_t node);
+        void RebuildPostings();
+        void Compact();
+
+        auto NodeAt(const fs::path& block) const
+          -> uint32_t;
+        auto LineNumbers(uint32_t node) const
+          -> std::vector<uint32_t>;
+
+    private:
+        fs::path                                            root;
+        std::vector<Node>                                   nodes;
+        std::vector<std::vector<uint32_t>>                  children;
+        //Trigram packed in the low 24 bits -> nodes whose text contains it, may hold stale ids
+        std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+        uint32_t                                            aliveNodes = 0;
+        bool                                                dirty      = false;
+
+        static std::unique_ptr<TrigramIndex> active;
+        static bool                          activeLoaded;
+    };
+}
+
+#endif
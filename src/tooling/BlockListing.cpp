@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#include "BlockListing.hpp"
+#include "Directory.hpp"
+#include "Memory.hpp"
+
+using BlockListing = zkb::BlockListing;
+namespace fs = zkb::fs;
+
+namespace
+{
+    constexpr std::size_t MAX_CACHED_BLOCKS = 256;
+
+    std::mutex                                                           cacheMutex;
+    std::unordered_map<std::string, std::shared_ptr<const BlockListing>> cache;
+    uint64_t                                                             currentGeneration = 1;
+
+    timespec ModifiedTime(const fs::path& path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return {};
+        return st.st_mtim;
+    }
+}
+
+std::string_view
+BlockListing::Line::Name() const
+{
+    const auto space = filename.find(' ');
+    return space == std::string_view::npos? filename : filename.substr(space + 1);
+}
+
+BlockListing::BlockListing(const fs::path& path) :
+    modified(ModifiedTime(path))
+{
+    std::vector<uint32_t> scanNumbers;
+    std::vector<uint32_t> scanOffsets;
+    std::vector<uint16_t> scanLengths;
+    std::vector<uint8_t>  scanFlags;
+
+    Directory::ForEachLine([&](const LineView& view)
+    {
+        scanNumbers.push_back(view.lineNumber);
+        scanOffsets.push_back(names.size());
+        scanLengths.push_back(view.filename.size());
+        scanFlags.push_back(view.isBlock? IS_BLOCK : 0);
+        names += view.filename;
+    }, path);
+
+    //Sorts indices, the arrays are then gathered once in line order
+    const auto Filename = [&](uint32_t i)
+    {
+        return std::string_view(names).substr(scanOffsets[i], scanLengths[i]);
+    };
+
+    std::vector<uint32_t> order(scanNumbers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        return scanNumbers[a] != scanNumbers[b]? scanNumbers[a] < scanNumbers[b] : Filename(a) < Filename(b);
+    });
+
+    //Names are copied in line order too so walking the listing reads the buffer front to back
+    std::string sorted;
+    sorted.reserve(names.size());
+
+    lineNumbers.resize(order.size());
+    offsets.resize(order.size());
+    lengths.resize(order.size());
+    flags.resize(order.size());
+    for (std::size_t i = 0; i < order.size(); i += 1)
+    {
+        lineNumbers[i] = scanNumbers[order[i]];
+        offsets[i]     = sorted.size();
+        lengths[i]     = scanLengths[order[i]];
+        flags[i]       = scanFlags[order[i]];
+        sorted += Filename(order[i]);
+    }
+    names = std::move(sorted);
+}
+
+std::shared_ptr<const BlockListing>
+BlockListing::Get(const fs::path& path)
+{
+    const timespec modified = ModifiedTime(path);
+
+    std::unique_lock lock(cacheMutex);
+    const uint64_t generation = currentGeneration;
+
+    auto it = cache.find(path.native());
+    if (it != cache.end())
+    {
+        const auto& listing = *it->second;
+        if (listing.generation == generation and
+            listing.modified.tv_sec == modified.tv_sec and listing.modified.tv_nsec == modified.tv_nsec)
+        {
+            return it->second;
+        }
+    }
+    lock.unlock();
+
+    Memory::Scope memory(Memory::Listings);
+    auto listing = std::make_shared<BlockListing>(path);
+    listing->generation = generation;
+
+    lock.lock();
+    if (cache.size() >= MAX_CACHED_BLOCKS) cache.clear();
+    cache.insert_or_assign(path.native(), listing);
+    return listing;
+}
+
+void
+BlockListing::Invalidate()
+{
+    std::lock_guard lock(cacheMutex);
+    currentGeneration += 1;
+}
+
+BlockListing::Line
+BlockListing::operator[](std::size_t index) const
+{
+    return
+    {
+        lineNumbers[index],
+        std::string_view(names).substr(offsets[index], lengths[index]),
+        (flags[index] & IS_BLOCK) != 0,
+    };
+}
+
+BlockListing::Iterator
+BlockListing::begin() const
+{
+    return {this, 0};
+}
+
+BlockListing::Iterator
+BlockListing::end() const
+{
+    return {this, lineNumbers.size()};
+}
+
+uint32_t
+BlockListing::Size() const
+{
+    return lineNumbers.size();
+}
+
+bool
+BlockListing::Empty() const
+{
+    return lineNumbers.empty();
+}
+
+std::size_t
+BlockListing::LowerBound(uint32_t lineNumber) const
+{
+    return std::lower_bound(lineNumbers.begin(), lineNumbers.end(), lineNumber) - lineNumbers.begin();
+}
+
+std::optional<BlockListing::Line>
+BlockListing::Find(uint32_t lineNumber) const
+{
+    const auto index = LowerBound(lineNumber);
+    if (index == lineNumbers.size() or lineNumbers[index] != lineNumber) return std::nullopt;
+    return (*this)[index];
+}
+
+std::optional<BlockListing::Line>
+BlockListing::FindName(std::string_view name) const
+{
+    for (std::size_t i = 0; i < lineNumbers.size(); i += 1)
+    {
+        const auto line = (*this)[i];
+        if (line.Name() == name) return line;
+    }
+    return std::nullopt;
+}
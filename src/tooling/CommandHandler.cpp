@@ -1,27 +1,45 @@
 #include <cassert>
+#include <charconv>
 #include <cctype>
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 
-#if DEBUG_BUILD
 #include <chrono>
-#endif
 #include <iostream>
 #include <functional>
 #include <filesystem>
+#include <fstream>
 #include <iterator>
-#include <sstream>
 #include <string>
 #include <string_view>
+#include <algorithm>
 #include <array>
+#include <future>
+#include <limits>
+#include <optional>
+#include <regex>
+#include <sstream>
+#include <utility>
 #include <vector>
 
 #include "Application.hpp"
 #include "other/CMakeVariables.h"
+#include "BlockListing.hpp"
 #include "CommandHandler.hpp"
+#include "CommandTable.hpp"
+#include "Counters.hpp"
 #include "Directory.hpp"
+#include "ProjectIO.hpp"
+#include "Memory.hpp"
+#include "Search.hpp"
+#include "Session.hpp"
+#include "SharedProject.hpp"
+#include "SubtreeStats.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "TrigramIndex.hpp"
 #include "Utils.hpp"
 #include "Helper.hpp"
 
@@ -45,6 +63,7 @@ namespace zkb
             if (lineNumber <= 0 || lineNumber > Dir::GetNumberOfDirs())
             {
                 std::cerr << "Line " << lineNumber << " is non-existant\n";
+                CommandHandler::failed = true;
                 return true;
             }
             return false;
@@ -55,6 +74,7 @@ namespace zkb
             if (lowerBound <= 0 || upperBound > Dir::GetNumberOfDirs())
             {
                 std::cerr << "Range (" << lowerBound << ',' << upperBound << ") is non-existant\n";
+                CommandHandler::failed = true;
                 return true;
             }
             return false;
@@ -63,46 +83,84 @@ namespace zkb
     private:
         Error();
     };
+
+    //A block with at least this many blocks among its lines renders each of them as a separate job
+    constexpr uint32_t TREE_SPLIT_BLOCKS = 8;
+
+    //Output of RenderTree, subtrees rendered by other jobs go in at their offset of text
+    struct RenderedTree
+    {
+        std::string                                                     text;
+        std::vector<std::pair<std::size_t, std::future<RenderedTree>>> subtrees;
+    };
+
+    /*
+     * Appends the lines of the block at path, and of their blocks, in line order.
+     * depth is the indentation level of the lines of path.
+     */
+    void RenderTree(const fs::path& path, uint32_t depth, uint32_t maxDepth, RenderedTree& out)
+    {
+        if (depth >= maxDepth) return;
+
+        const BlockListing listing(path);
+
+        uint32_t blocks = 0;
+        for (const auto line : listing) blocks += line.isBlock;
+        const bool split = blocks >= TREE_SPLIT_BLOCKS and depth + 1 < maxDepth;
+
+        for (const auto line : listing)
+        {
+            out.text.append(depth * 3 + 4, ' ');
+            out.text += "|- ";
+            out.text += line.filename;
+            out.text += '\n';
+
+            if (!line.isBlock) continue;
+            if (!split)
+            {
+                RenderTree(path / line.filename, depth + 1, maxDepth, out);
+                continue;
+            }
+
+            auto subtree = ThreadPool::Shared().Submit([path = path / line.filename, depth, maxDepth]()
+            {
+                RenderedTree out;
+                RenderTree(path, depth + 1, maxDepth, out);
+                return out;
+            });
+            out.subtrees.emplace_back(out.text.size(), std::move(subtree));
+        }
+    }
+
+    //Writes tree in line order, waiting on the jobs of its subtrees as it reaches them
+    void WriteTree(RenderedTree& tree, std::ostream& out)
+    {
+        std::size_t written = 0;
+        for (auto& [offset, job] : tree.subtrees)
+        {
+            out.write(tree.text.data() + written, offset - written);
+            written = offset;
+
+            auto subtree = job.get();
+            WriteTree(subtree, out);
+        }
+        out.write(tree.text.data() + written, tree.text.size() - written);
+    }
 }
 
 void 
 CommandHandler::WrongUsage(Command command, bool crash /* = false*/)
 {
-    switch (command)
+    const auto* spec = zkb::CommandTable::Find(command);
+    if (spec != nullptr)
     {
-        case Command::Line:
-        {
-            std::cerr << "Error adding a line: Wrong usage\n";
-        } break;
-        case Command::SetLine:
-        {
-            std::cerr << "Error setting current line: Wrong usage\n";
-        } break;
-        case Command::Delete:
-        {
-            std::cerr << "Error removing line(s): Wrong usage\n";
-        } break;
-        case Command::Change:
-        {
-            std::cerr << "Error changing line(s): Wrong usage\n";
-        } break;
-        case Command::Move:
-        {
-            std::cerr << "Error moving line(s): Wrong usage\n";
-        } break;
-        case Command::Swap:
-        {
-            std::cerr << "Error swaping line(s): Wrong usage\n";
-        } break;
-        case Command::LS:
-        {
-            std::cerr << "Error listing line(s): Wrong usage\n";
-        } break;
-        default:
-        {
-            std::cerr << "Wrong Usage\n";
-        } break;
+        std::cerr << "Error " << spec->action << ": Wrong usage\n";
+    }
+    else
+    {
+        std::cerr << "Wrong Usage\n";
     }
+    failed = true;
     if (crash) Application::Exit(EXIT_FAILURE);
 }
 
@@ -121,15 +179,45 @@ CommandHandler::WrongUsage(Setup setupError, bool crash /* = false*/)
             std::cerr << "Wrong Usage\n";
         } break;
     }
+    failed = true;
     if (crash) Application::Exit(EXIT_FAILURE);
 }
 
+template <typename Func>
+void
+CommandHandler::RangedDirectoryIteration(Func&& func)
+{
+    const auto lowerBound = range.num.at(0);
+    const auto upperBound = range.num.at(1);
+
+    Dir::ForEachLine([&](const zkb::LineView& view)
+    {
+        if (view.lineNumber >= lowerBound && view.lineNumber <= upperBound)
+        {
+            func(view);
+        }
+    });
+}
+
+template <typename Func>
+void
+CommandHandler::GenericDirectoryIteration(Func&& func)
+{
+    Dir::ForEachLine(std::forward<Func>(func));
+}
+
+bool CommandHandler::failed = false;
+
 fs::path CommandHandler::basedPath = fs::current_path();
 fs::path CommandHandler::rootPath  = CommandHandler::basedPath;
 
 void 
 CommandHandler::ShowBasedPath()
 {
+    if (!showPrompt) return;
+
+    zkb::Trace::Span span("prompt", "output");
+
     fs::path relevantPath = basedPath;
     std::string relevantPathStr;
 
@@ -145,14 +233,55 @@ CommandHandler::ShowBasedPath()
     std::cout << currentLine << '|' << relevantPathStr << "> ";
 }
 
-CommandHandler::CommandHandler()
+/**
+ * Asks question on std::cin, true on y. Without a prompt (--json, the daemon, replays)
+ * std::cin holds commands and not answers, so it's a no and the command fails.
+ */
+bool
+CommandHandler::Confirm(std::string_view question)
+{
+    if (!showPrompt)
+    {
+        std::cerr << question << " No, there's no prompt to answer it\n";
+        failed = true;
+        return false;
+    }
+
+    //Other sessions aren't kept waiting on the write lock for a keypress
+    auto* shared = zkb::SharedProject::Active();
+    if (shared != nullptr) shared->Suspend();
+
+    char response = 'n';
+    std::cout << question << " y/n: " << std::flush;
+    std::cin  >> response;
+
+    if (shared != nullptr and !shared->Resume())
+    {
+        std::cerr << "Another session changed the project meanwhile, run the command again\n";
+        failed = true;
+        return false;
+    }
+    return std::tolower(response) == 'y';
+}
+
+CommandHandler::CommandHandler(bool interactive /* = true*/)
+{
+    if (!SetupRoot() or !interactive) return;
+    Run();
+}
+
+/**
+ * Walks up from the current directory to the project's .zkb root
+ */
+bool
+CommandHandler::SetupRoot()
 {
     while (true)
     {
         if (zkb::Error::NoRootDirectory(rootPath))
         {
             WrongUsage(Setup::RootDirectory);
-            return;
+            return false;
         }
 
         const auto& rootStr  = rootPath.filename().string();
@@ -162,21 +291,52 @@ CommandHandler::CommandHandler()
         {
             if (rootStr.substr(startPos, 4) == ".zkb")
             {
-                break;
+                return true;
             }
         }
         rootPath = rootPath.parent_path();
     }
+}
 
+void
+CommandHandler::Run()
+{
     std::string command;
-    bool quit = false;
  
+    zkb::Session::Begin(rootPath, basedPath);
+
     ShowBasedPath();
     while (!quit && std::getline(std::cin, command))
     {
-        command += ' ';
-        size_t pos     = command.find(' ');
-        size_t wordBeg = 0;
+        zkb::Session::Log(command);
+
+        if (jsonOutput) ExecuteJson(std::move(command));
+        else            Execute(std::move(command));
+    }
+
+    zkb::TrigramIndex::FlushActive();
+}
+
+bool
+CommandHandler::Execute(std::string command)
+{
+    failed = false;
+    if (command.find_first_not_of(' ') == std::string::npos)
+    {
+        ShowBasedPath();
+        return false;
+    }
+
+    zkb::Trace::Span span("execute", "command");
+    span.Arg("line", command);
+
+    command += ' ';
+    size_t pos     = command.find(' ');
+    size_t wordBeg = 0;
+
+    {
+        zkb::Trace::Span   parse("parse", "command");
+        zkb::Memory::Scope memory(zkb::Memory::Parse);
 
         //Splitting
         for (arg.c = 0; pos != std::string::npos; arg.c += 1)
@@ -184,7 +344,9 @@ CommandHandler::CommandHandler()
             if (arg.c >= CommandHandler::MAX_ARGS)
             {
                 std::cerr << "Too many args. argc = " << arg.c << "\n";
-                Application::Exit(EXIT_FAILURE);
+                failed = true;
+                ShowBasedPath();
+                return false;
             }
             
             const auto& subStr = command.substr(wordBeg, pos - wordBeg);
@@ -194,35 +356,147 @@ CommandHandler::CommandHandler()
             auto nextPos = command.find(' ', wordBeg);
             pos = nextPos;
         }
-        
-        auto saveLastCommand = lastCommand;
-        lastCommand = Command::None;
-
-        /* 
-         * For some reason swap has a std::invalid_argument exception when you swap with 
-         * upperbound + numberOfLinesToShift > numberOfDirs
-         */
-        try
+    }
+    
+    auto saveLastCommand = lastCommand;
+    lastCommand = Command::None;
+
+    /* 
+     * For some reason swap has a std::invalid_argument exception when you swap with 
+     * upperbound + numberOfLinesToShift > numberOfDirs
+     */
+    try
+    {
+        quit = Handle();
+    }
+    catch (const std::invalid_argument&)
+    {
+        if (saveLastCommand != Command::Swap)
         {
-            quit = Handle();
+            std::cerr << "std::invalid_argument\n";
+            failed = true;
+            ShowBasedPath();
+            return false;
         }
-        catch (std::invalid_argument)
+
+        if constexpr (DEBUG_BUILD)
         {
-            if (saveLastCommand != Command::Swap)
-            {
-                std::cerr << "std::invalid_argument\n";
-                ShowBasedPath();
-                continue;
-            }
+            std::cerr << "possibly unknown std::invalid_argument\n";
+            ShowBasedPath();
+            return false;
+        }
+    }
+    return quit;
+}
 
-            if constexpr (DEBUG_BUILD)
-            {
-                std::cerr << "possibly unknown std::invalid_argument\n";
-                ShowBasedPath();
-                continue;
-            }
+/**
+ * {"command":..,"status":"ok"|"error"|"quit","block":"2/1","lines":..,"delta":..,"us":..,
+ *  "output":..,"errors":..}
+ * block is the line number path of the block after the command, lines its number of
+ * lines and delta the change of it when the command didn't leave the block. Output
+ * lines lose their indentation so they can be used as they are.
+ */
+bool
+CommandHandler::ExecuteJson(std::string command)
+{
+    static std::string record;
+
+    const auto linesIn = [](const fs::path& block) -> int64_t
+    {
+        return zkb::BlockListing::Get(block)->Size();
+    };
+
+    const auto undecorated = [](std::string_view text)
+    {
+        std::string out;
+        while (!text.empty())
+        {
+            auto line = text.substr(0, text.find('\n'));
+            text.remove_prefix(std::min(text.size(), line.size() + 1));
+
+            line.remove_prefix(std::min(line.size(), line.find_first_not_of('\t')));
+            if (line.empty()) continue;
+
+            out += line;
+            out += '\n';
         }
+        return zkb::JsonEscape(out);
+    };
+
+    const auto     blockBefore  = basedPath;
+    const int64_t  linesBefore  = linesIn(basedPath);
+
+    std::ostringstream output;
+    std::ostringstream errors;
+    auto* coutBuffer = std::cout.rdbuf(output.rdbuf());
+    auto* cerrBuffer = std::cerr.rdbuf(errors.rdbuf());
+
+    const auto start  = std::chrono::steady_clock::now();
+    const bool result = Execute(command);
+    const auto end    = std::chrono::steady_clock::now();
+
+    std::cout.rdbuf(coutBuffer);
+    std::cerr.rdbuf(cerrBuffer);
+
+    std::string blockPath;
+    for (const auto& component : basedPath.lexically_relative(rootPath))
+    {
+        if (component == ".") continue;
+        if (!blockPath.empty()) blockPath += '/';
+        blockPath += std::to_string(Dir::GetDirectoryLineNumber(component));
+    }
+
+    const int64_t linesAfter = linesIn(basedPath);
+    const char*   status     = result? "quit" : failed? "error" : "ok";
+
+    record.clear();
+    record += "{\"command\":\"";
+    record += zkb::JsonEscape(command);
+    record += "\",\"status\":\"";
+    record += status;
+    record += "\",\"block\":\"";
+    record += zkb::JsonEscape(blockPath);
+    record += "\",\"lines\":";
+    record += std::to_string(linesAfter);
+    if (basedPath == blockBefore)
+    {
+        record += ",\"delta\":";
+        record += std::to_string(linesAfter - linesBefore);
     }
+    record += ",\"us\":";
+    record += std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    record += ",\"output\":\"";
+    record += undecorated(output.view());
+    record += "\",\"errors\":\"";
+    record += undecorated(errors.view());
+    record += "\"}\n";
+
+    //One write per record, flushed so consumers on a pipe see it right away
+    zkb::Trace::Span span("output", "output");
+    std::cout.write(record.data(), record.size());
+    std::cout.flush();
+    return result;
+}
+
+bool
+CommandHandler::ChangeBlock(const fs::path& block)
+{
+    if (block == basedPath) return true;
+
+    const auto relative = block.lexically_relative(rootPath);
+    std::error_code err;
+    if (relative.empty() or *relative.begin() == ".." or !fs::is_directory(block, err))
+    {
+        std::cerr << block.string() << " is not a block of " << rootPath.string() << '\n';
+        failed = true;
+        return false;
+    }
+
+    fs::current_path(block);
+    Dir::updateNumberOfDirs = true;
+    basedPath   = block;
+    currentLine = 1;
+    return true;
 }
 
 bool
@@ -250,120 +524,131 @@ CommandHandler::Handle()
     if (forceCommand)
         commandStr    = commandStr.substr(1, commandStr.size());
 
-    auto checkCommand = [commandStr](const std::initializer_list<const std::string_view>& args)
+    const auto* spec = zkb::CommandTable::Find(commandStr);
+    if (spec == nullptr)
     {
-        for (const auto& arg : args)
-        {
-            if (commandStr == arg)
-            {
-                return true;
-            }
-            // std::cerr << '"' << commandStr << "\" fails on arg " << arg << '\n';
-        }
+        WrongUsage(Command::None);
+        ShowBasedPath();
         return false;
-    };
-
-    if (checkCommand({"q", "quit", "exit"})) return true;
+    }
 
-    auto evaluate = [&]() -> void(CommandHandler::*)()
+    const uint32_t operands = OperandCount();
+    if (operands < spec->minArgs or operands > spec->maxArgs)
+    {
+        WrongUsage(spec->command);
+        std::cerr << spec->usage;
+    }
+    else if (spec->handler == nullptr)
     {
-        // std::cerr << "Command: ";
-        // for (const auto& arg : arg.v)
-        // {
-        //     std::cerr << arg << ", ";
-        // }
-        // std::cerr << "\nargc = " << arg.c << '\n';
+        std::cerr << "Not implemented.\n";
+        failed = true;
+    }
+    else
+    {
+        zkb::Counters::Scope counters(spec->command);
+        zkb::Trace::Span     span(spec->aliases[0], "command");
 
-        using CH = CommandHandler;
-        if (checkCommand({"l", "line"}))
-        {
-            return &CH::HandleNewLine;
-        }
-        else if (checkCommand({"d", "delete"}))
-        {
-            return &CH::HandleLineDelete;
-        }
-        else if (checkCommand({"u", "undo"}))
-        {
-            return &CH::HandleUndo;
-        }
-        else if (checkCommand({"r", "redo"}))
+        //Mutating commands run under the project write lock and are published as one batch
+        auto* shared = zkb::SharedProject::Active();
+        std::optional<zkb::SharedProject::WriteLock> writeLock;
+        if (shared != nullptr and spec->mutates) writeLock.emplace(*shared, basedPath);
+        SyncSharedChanges();
+
+        const uint32_t times = spec->repeatable? repetionNumber : 1;
+        for (iteration = 0; iteration < times and !quit; iteration += 1)
         {
-            return &CH::HandleRedo;
+            std::invoke(spec->handler, this);
         }
-        else
+
+        if (spec->mutates)
         {
-            return nullptr;
+            zkb::Trace::Span invalidate("invalidate", "cache");
+
+            zkb::BlockListing::Invalidate();
+            zkb::SubtreeStats::Invalidate(basedPath, rootPath);
+            if (auto* index = zkb::TrigramIndex::Active()) index->Refresh(basedPath);
         }
-    };
+    }
+
+    if (quit) return true;
+
+    ShowBasedPath();
+    return false;
+}
+
+/**
+ * Other sessions only publish the blocks they edited, so only those lose their
+ * cached stats and index entries. The current block may have been renumbered by
+ * them, the process cwd follows it.
+ */
+void
+CommandHandler::SyncSharedChanges()
+{
+    auto* shared = zkb::SharedProject::Active();
+    if (shared == nullptr) return;
+
+    zkb::Trace::Span span("sync", "cache");
+
+    std::vector<fs::path> changed;
+    const bool complete = shared->Changes(changed);
+    if (complete and changed.empty()) return;
 
-    auto func = evaluate();
-    if (func != nullptr)
+    zkb::BlockListing::Invalidate();
+    Dir::updateNumberOfDirs = true;
+
+    auto* index = zkb::TrigramIndex::Active();
+    if (complete)
     {
-        for (iteration = 0; iteration < repetionNumber; iteration += 1)
+        for (const auto& block : changed)
         {
-            std::invoke(func, this);
+            zkb::SubtreeStats::Invalidate(block, rootPath);
+            if (index != nullptr) index->Refresh(block);
         }
     }
     else
     {
-        //Non repeatable commands
-        if (checkCommand({"cd"}))
-        {
-            ChangeDirectory();
-        }
-        else if (checkCommand({"c", "change"}))
-        {
-            HandleLineChange();
-        }
-        else if (checkCommand({"ls"}))
-        {
-            ListCurrentDirectory();
-        }
-        else if (checkCommand({"sl"}))
-        {
-            SetCurrentLine();
-        }
-        else if (checkCommand({"s", "swap"}))
-        {
-            HandleLineSwap();
-        }
-        else if (commandStr == "ref")
-        {
-            DebugRefresh();
-        }
-        else if (commandStr == "clean")
-        {
-            Dir::RecursivelyDelete(fs::directory_entry(fs::current_path()), false);
-        }
-        else if (checkCommand({"s", "status"}))
-        {
-            ShowStatus();
-        }
-        else if (checkCommand({"info"}))
-        {
-            GetDirInfo();
-        }
-#if DEBUG_BUILD
-        else if (checkCommand({"b"}))
-        {
-            std::system("b");
-            Application::Exit();
-        }
-        else if (checkCommand({"bn"}))
+        zkb::SubtreeStats::Invalidate();
+        if (index != nullptr) index->CheckModified();
+    }
+
+    std::error_code err;
+    if (auto cwd = fs::current_path(err); !err and cwd != basedPath)
+    {
+        basedPath = std::move(cwd);
+    }
+}
+
+/**
+ * Number of operands after the command word, a quoted string spanning
+ * several args counts as a single operand.
+ */
+uint32_t
+CommandHandler::OperandCount() const
+{
+    uint32_t count    = 0;
+    bool     inString = false;
+    for (uint32_t i = 1; i < arg.c; i += 1)
+    {
+        const auto& elem = arg.v.at(i);
+        if (elem.empty()) continue;
+
+        if (!inString)
         {
-            Command command = static_cast<Command>(std::stoi(arg.v.at(1)));
-            Benchmark(command, {arg.v.at(2), arg.v.at(3), arg.v.at(4), arg.v.at(5)});
+            count += 1;
+            inString = elem.starts_with('"') and (elem.size() == 1 or !elem.ends_with('"'));
         }
-#endif
-        else 
+        else if (elem.ends_with('"') and !elem.ends_with("\\\""))
         {
-            WrongUsage(Command::None);
+            inString = false;
         }
     }
+    return count;
+}
 
-    ShowBasedPath();
-    return false;
+void
+CommandHandler::HandleQuit()
+{
+    quit = true;
 }
 
 void 
@@ -383,37 +668,22 @@ CommandHandler::HandleNewLine()
         }
     }
 
-    static uint32_t nameRepetion = 0;
-
     std::string& lineNumberArg = *lineNumberPtr;
 
     //Final directory name
     std::string finalName;
 
-    constexpr static std::string TEMP = ".temp";
-
     /*
-     * When a line updates to accomodate for a new line it might be the case that they have
-     * the exact same filename: 1 example | 2 example -> 2 example | 2 example, 
-     * therefore we append some text to the filename so conflict doesn't happen:
-     * 2 example.temp1 | 2 example.
+     * Lines at and after the new one move down before it is created. ShiftLines renames
+     * from the last line backwards, so equal texts never collide: 1 example | 2 example
+     * becomes 2 example | 3 example without temporary names.
      */
-    bool solveTemporaries = false;
-    auto checkForSameName = [&](const std::string& nameToCheck, uint32_t referentialLineNumber)
+    auto makeRoom = [&]()
     {
-        if (referentialLineNumber > Dir::GetNumberOfDirs()) return;
-        GenericDirectoryIteration([&](zkb::Directory dir)
+        if (lastCommand != Command::Line and currentLine <= Dir::GetNumberOfDirs())
         {
-            if (dir.LineNumber() >= referentialLineNumber)
-            {
-                const auto& checkName = nameToCheck.substr(nameToCheck.find_first_of(' ') + 1, nameToCheck.size() - nameToCheck.find_first_of(' ') + 1);
-                if (dir.Name() == checkName)
-                {
-                    solveTemporaries = true;
-                    dir.Name(nameToCheck.substr(nameToCheck.find_first_of(' ') + 1, nameToCheck.size()) + TEMP + std::to_string(dir.LineNumber()));
-                }
-            }
-        });
+            Dir::ShiftLines(basedPath, currentLine, repetionNumber);
+        }
     };
 
     switch (arg.c)
@@ -421,14 +691,14 @@ CommandHandler::HandleNewLine()
         case 1:
         {
             finalName = std::to_string(currentLine) + " '...'";
-            checkForSameName(finalName, currentLine);
+            makeRoom();
 
             Dir::CreateDirectory(finalName);
         } break;
         case 2:
         {
             finalName = std::to_string(currentLine) + " " + finalText;
-            checkForSameName(finalName, currentLine);
+            makeRoom();
 
             Dir::CreateDirectory(finalName);
         } break;
@@ -437,86 +707,34 @@ CommandHandler::HandleNewLine()
             if (!zkb::IsInteger(lineNumberArg))
             {
                 std::cerr << "Not passing a positive integer for line number\n";
-                Application::Exit(EXIT_FAILURE);
+                failed = true;
+                return;
             }
 
 
-            const uint32_t lineNum = std::stoi(lineNumberArg);
+            //Repeated lines go after the previous one: "3 l $ #" fills # to # + 2
+            const uint32_t lineNum = lastCommand == Command::Line? currentLine : std::stoi(lineNumberArg);
             if (lineNum > Dir::GetNumberOfDirs() + 1 or lineNum == 0)
             {
                 std::cout << "Line " << lineNumberArg << " must already exist and be greater than 0.\n";
-                char response;
-
-                std::cout << "Create at last line? y/n: " << std::flush;
-                std::cin  >> response;
-
-                if (std::tolower(response) == 'y')
+                if (Confirm("Create at last line?"))
                 {
-                    Dir::CreateDirectory(std::to_string(Dir::GetNumberOfDirs()) + " " + finalText);
+                    Dir::CreateDirectory(std::to_string(Dir::GetNumberOfDirs() + 1) + " " + finalText);
+                    updateDirectoriesList = true;
                 }
                 return;
             }
             
             currentLine = lineNum;
 
-            if (iteration + 1 == repetionNumber)
-            {
-                lineNumberArg += " ";
-                lineNumberArg += std::move(finalText);
-                finalName     =  std::move(lineNumberArg);
-            }
-            else
-                finalName = lineNumberArg + " " + finalText;
+            finalName = std::to_string(currentLine) + " " + finalText;
 
-            checkForSameName(finalName, currentLine);
+            makeRoom();
             Dir::CreateDirectory(finalName, basedPath);
         } break;
         default: WrongUsage(Command::Line); return;
     }
 
-    if (lastCommand != Command::Line)
-    {
-        // std::cout << Dir::GetNumberOfDirs() << '\n';
-        if (currentLine <= Dir::GetNumberOfDirs())
-        {
-            GenericDirectoryIteration([&](zkb::Directory dir)
-            {
-                // std::cout << "dir.Name().ends_with(\"temp\"): " << dir.Name().ends_with(TEMP) << '\n';
-                // std::cout << "finalName != dir.Filename(): " << (finalName != dir.Filename()) << '\n';
-                // std::cout << "finalName: " << finalName << '\n';
-                // std::cout << "dirName: " << dir.Filename() << '\n';
-                // if (dir.Name().find(TEMP) != std::string::npos)
-                // {
-                //     std::cout << "Creating new line with current line being the same name as the text argument.\nAccomodating.\n";
-                //     dir.LineNumber(dir.LineNumber() + repetionNumber);
-                //     return;
-                // }
-
-                // std::cout << dir.Filename() << '\n';
-                if (dir.LineNumber() >= currentLine && finalName != dir.Filename())
-                {
-                    std::cout << "Change " << dir.Filename() << "\n";
-                    checkForSameName(dir.Name(), dir.LineNumber() + repetionNumber);
-                    dir.LineNumber(dir.LineNumber() + repetionNumber);
-                }
-            });
-        }
-    }
-
-    //Handle case where the directory at current line is the same name as the new
-    if (solveTemporaries)
-    {
-        GenericDirectoryIteration([&](zkb::Directory dir)
-        {
-            if (dir.Name().find(TEMP) != std::string::npos)
-            {
-                const auto& name       = dir.Name();
-                const auto  revertName = name.substr(0, name.find(TEMP));
-                dir.Name(std::move(revertName));
-            }
-        });
-    }
-
     currentLine += 1;
 
     lastCommand = Command::Line;
@@ -534,7 +752,7 @@ CommandHandler::SetCurrentLine()
     {
         case 1:
         {
-            if (line == numberOfLines) return;
+            if (currentLine == numberOfLines + 1) return;
             line = numberOfLines + 1;
         } break;
         case 2:
@@ -579,6 +797,7 @@ CommandHandler::HandleLineDelete()
     if (lowerBound > upperBound)
     {
         std::cerr << "Lower bound (" << lowerBound << ") cannot be > upperbound (" << upperBound << ").\n";
+        failed = true;
         return;
     }
 
@@ -587,9 +806,9 @@ CommandHandler::HandleLineDelete()
     dirs.reserve(upperBound - lowerBound + isRanged);
     if (isRanged)
     {
-        RangedDirectoryIteration([&](const fs::directory_entry& elem, uint32_t)
+        RangedDirectoryIteration([&](const zkb::LineView& view)
         {
-            dirs.emplace_back(std::move(elem));
+            dirs.emplace_back(basedPath / view.filename);
         });
     }
     else
@@ -606,6 +825,7 @@ CommandHandler::HandleLineDelete()
             if (currentLine > numberOfDirs)
             {
                 std::cerr << "Can't delete at current line: directory at line " << currentLine << " is non-existant\n";
+                failed = true;
                 return;
             }
 
@@ -619,12 +839,13 @@ CommandHandler::HandleLineDelete()
             if (!zkb::IsInteger(lineNumberArg))
             {
                 std::cerr << "Not passing an integer for line number\n";
+                failed = true;
                 return;
             }
 
             referenceLineNumber = std::stoi(lineNumberArg);
             dir = Dir::DirectoryInLine(referenceLineNumber);
-            std::cerr << "Dir in line is " << dir.path().filename().string() << '\n';
+            DEBUG_OUT("Dir in line is " << dir.path().filename().string());
         } break;
         default: WrongUsage(Command::Delete); return;
     }
@@ -635,6 +856,7 @@ CommandHandler::HandleLineDelete()
         {
             std::cerr << "Trying to delete a non-empty directory."
                 "To confirm command use [-d|-delete].\n";
+            failed = true;
             return;
         }
     }
@@ -642,6 +864,12 @@ CommandHandler::HandleLineDelete()
     for (uint32_t i = 0; i < upperBound - lowerBound + isRanged; i += 1)
     {
         currentLine -= currentLine > 1;
+        if (undoing)
+        {
+            Dir::RemoveSubtree(dirs.at(i));
+            continue;
+        }
+
         if (fs::is_empty(dirs.at(i))) 
         {
             Dir::RemoveDirectory(dirs.at(i));
@@ -650,15 +878,16 @@ CommandHandler::HandleLineDelete()
 
         Dir::RecursivelyDelete(dirs.at(i));
     }
+    //Subtree deletes count their nested lines too
+    Dir::updateNumberOfDirs = true;
 
-    if (upperBound == numberOfDirs) return;
-    GenericDirectoryIteration([&](zkb::Directory dir)
+    //Lines after the deleted ones move up, in ascending order so equal texts never collide
+    const uint32_t lastDeleted = isRanged? upperBound : referenceLineNumber;
+    const int32_t  deleted     = upperBound - lowerBound + isRanged;
+    if (lastDeleted < numberOfDirs)
     {
-        if (dir.LineNumber() > (isRanged? upperBound : referenceLineNumber))
-        {
-            dir.LineNumber(dir.LineNumber() - (upperBound - lowerBound + isRanged));
-        }
-    });
+        Dir::ShiftLines(basedPath, lastDeleted + 1, -deleted);
+    }
 
     lastCommand = Command::Delete;
     updateDirectoriesList = true;
@@ -669,6 +898,7 @@ CommandHandler::HandleLineChange()
 {
     //Raw text or line number of a another directory
     std::string& arg1          = arg.v.at(1);
+    lineNumberPtr              = &arg.v.at(2);
 
     if (!ParseStringText(arg1))
     {
@@ -690,15 +920,18 @@ CommandHandler::HandleLineChange()
             std::string lineNumberStr       = std::to_string(currentLine);
 
             const auto& dir                 = Dir::DirectoryInLine(currentLine);
-            const auto& parent              = dir.path().parent_path().string();
 
             const auto& saveName = Dir::GetDirectoryName(dir).insert(0, "\"") + '"';
             const auto& rangeStr = std::string("(") + lineNumberStr + "," + lineNumberStr + ")";
 
             //Save
-            Dir::history.push({{{"c", saveName, rangeStr}, 3}, basedPath});
+            if (!undoing)
+            {
+                zkb::Memory::Scope memory(zkb::Memory::History);
+                Dir::history.push({{{"c", saveName, rangeStr}, 3}, basedPath});
+            }
             
-            fs::rename(dir.path(), parent + '\\' + lineNumberStr + ' ' + finalText);
+            Dir::ChangeDirectoryName(dir, finalText);
 
         } break;
         case 3:
@@ -726,18 +959,17 @@ CommandHandler::HandleLineChange()
             if (zkb::Error::NonExistantLine(lowerBound, upperBound)) return;
             if (zkb::IsInteger(arg1))
             {
-                RangedDirectoryIteration([arg1](const fs::directory_entry& elem, uint32_t lineNumber)
+                const auto sourceName = Dir::GetDirectoryName(Dir::DirectoryInLine(std::stoi(arg1)));
+                RangedDirectoryIteration([&](const zkb::LineView& view)
                 {
-                    const auto& parent = elem.path().parent_path().string();
-                    fs::rename(elem.path(), parent + "\\" + std::to_string(lineNumber) + ' ' + Dir::GetDirectoryName(Dir::DirectoryInLine(std::stoi(arg1))));
+                    Dir::RenameLine(view, view.lineNumber, sourceName);
                 });
             }
             else
             {
-                RangedDirectoryIteration([arg1, this](const fs::directory_entry& elem, uint32_t lineNumber)
+                RangedDirectoryIteration([this](const zkb::LineView& view)
                 {
-                    const auto& parent = elem.path().parent_path().string();
-                    fs::rename(elem.path(), parent + "\\" + (std::to_string(lineNumber) + ' ') + finalText);
+                    Dir::RenameLine(view, view.lineNumber, finalText);
                 });
             }
         } break;
@@ -819,12 +1051,7 @@ CommandHandler::HandleLineSwap()
         {
             if (upperBound + numberOfLinesToShift > numberOfLines)
             {
-                std::cout << "Can't fit! Create new lines to accomodate for this? y/n: ";
-
-                char response;
-                std::cin >> response;
-
-                if (std::tolower(response) == 'y')
+                if (Confirm("Can't fit! Create new lines to accomodate for this?"))
                 {
                     auto tempCurrentLine = currentLine;
                     currentLine = numberOfLines + 1;
@@ -900,6 +1127,104 @@ CommandHandler::HandleLineSwap()
     updateDirectoriesList = true;
 }
 
+void
+CommandHandler::HandleYank()
+{
+    uint32_t first = currentLine;
+    uint32_t last  = currentLine;
+
+    if (arg.c == 2)
+    {
+        const auto& lineArg = arg.v.at(1);
+        if (!lineArg.empty() and zkb::IsInteger(lineArg))
+        {
+            first = last = std::stoi(lineArg);
+        }
+        else if (lineArg.size() >= 3 and lineArg.starts_with('(') and lineArg.ends_with(')'))
+        {
+            //(1#,2#), either bound may be left out: (,2#) (1#,) (,)
+            const auto comma = lineArg.find(',');
+            const auto lower = lineArg.substr(1, comma - 1);
+            const auto upper = comma == std::string::npos? "" : lineArg.substr(comma + 1, lineArg.size() - comma - 2);
+
+            if (comma == std::string::npos or !zkb::IsInteger(lower) or !zkb::IsInteger(upper))
+            {
+                WrongUsage(Command::Yank);
+                std::cerr << "Malformed range\n";
+                return;
+            }
+
+            first = lower.empty()? 1 : std::stoi(lower);
+            last  = upper.empty()? Dir::GetNumberOfDirs() : std::stoi(upper);
+        }
+        else
+        {
+            WrongUsage(Command::Yank);
+            return;
+        }
+    }
+
+    if (first > last or zkb::Error::NonExistantLine(first, last)) return;
+
+    clipboard = std::make_shared<const zkb::ProjectIO::LineTree>(zkb::ProjectIO::ReadLines(basedPath, first, last));
+    std::cout << "Yanked " << clipboard->NumberOfTopLevelLines() << " line(s), "
+        << clipboard->nodes.size() << " with their blocks\n";
+}
+
+void
+CommandHandler::HandlePut()
+{
+    if (clipboard == nullptr or clipboard->nodes.empty())
+    {
+        std::cerr << "Nothing yanked\n";
+        failed = true;
+        return;
+    }
+
+    uint32_t line = currentLine;
+    if (arg.c == 2)
+    {
+        if (arg.v.at(1).empty() or !zkb::IsInteger(arg.v.at(1)))
+        {
+            WrongUsage(Command::Put);
+            return;
+        }
+        line = std::stoi(arg.v.at(1));
+    }
+
+    if (line == 0 or line > Dir::GetNumberOfDirs() + 1)
+    {
+        WrongUsage(Command::Put);
+        std::cerr << "Line " << line << " must be between 1 and " << Dir::GetNumberOfDirs() + 1 << '\n';
+        return;
+    }
+
+    //One gap for all the lines instead of a shift per line
+    const uint32_t numberOfLines = clipboard->NumberOfTopLevelLines();
+    if (!Dir::ShiftLines(basedPath, line, numberOfLines))
+    {
+        std::cerr << "Couldn't make room at line " << line << '\n';
+        failed = true;
+        return;
+    }
+
+    const bool created = zkb::ProjectIO::CreateLines(*clipboard, basedPath, line);
+    Dir::updateNumberOfDirs = true;
+    if (!created)
+    {
+        std::cerr << "Couldn't put every line\n";
+        failed = true;
+    }
+
+    const auto rangeStr = std::string("(") + std::to_string(line) + "," + std::to_string(line + numberOfLines - 1) + ")";
+    zkb::Memory::Scope memory(zkb::Memory::History);
+    Dir::history.push({{{"-d", rangeStr}, 2}, basedPath});
+
+    currentLine = line + numberOfLines;
+    lastCommand = Command::Put;
+    updateDirectoriesList = true;
+}
+
 void
 CommandHandler::HandleUndo()
 {
@@ -907,124 +1232,222 @@ CommandHandler::HandleUndo()
     if (history.empty())
     {
         std::cerr << "No changes to undo\n";
+        failed = true;
         return;
     }
 
-    bool repeat = arg.v.at(1) == "all";
+    [[maybe_unused]] bool repeat = arg.v.at(1) == "all";
     // repeat = true;
 
     // while (!history.empty())
     // {
-        HistoryT& historyV = history.top();
-        
-        arg.v = historyV.args.v;
+        //Popped before replaying it, the replayed command runs with the stack as it will be left
+        HistoryT historyV = std::move(history.top());
+        history.pop();
+
+        arg.v = std::move(historyV.args.v);
         arg.c = historyV.args.c;
 
-        basedPath = std::move(historyV.path);
-    
-        Handle();
-        history.pop();
+        //The entry runs in the block it was saved in, the session stays in its own
+        const auto previousPath = std::exchange(basedPath, std::move(historyV.path));
+        Dir::updateNumberOfDirs = true;
+
+        undoing = true;
+        try
+        {
+            Handle();
+        }
+        catch (...)
+        {
+            undoing = false;
+            basedPath = previousPath;
+            throw;
+        }
+        undoing = false;
+        basedPath = previousPath;
+        Dir::updateNumberOfDirs = true;
         // if (!repeat) break;
     // }
     // basedPath = fs::current_path();
 }
 
-void
-CommandHandler::HandleRedo()
-{
-    std::cerr << "Not implemented. Forwading to undo command\n";
-    HandleUndo();
+void
+CommandHandler::HandleRedo()
+{
+    std::cout << "Not implemented. Forwading to undo command\n";
+    HandleUndo();
+}
+
+void
+CommandHandler::ShowStatus()
+{
+    if (arg.c == 2)
+    {
+        if (arg.v.at(1) != "-r")
+        {
+            WrongUsage(Command::Status);
+            return;
+        }
+
+        ShowSubtreeStats(basedPath);
+        return;
+    }
+
+    std::cout << "Number of lines: " << Dir::GetNumberOfDirs() << '\n';
+}
+
+void
+CommandHandler::GetDirInfo()
+{
+    const bool recursive = arg.c == 3 and arg.v.at(1) == "-r";
+    if (arg.c != 2 and !recursive)
+    {
+        WrongUsage(Command::Info);
+        return;
+    }
+
+    const auto& lineArg = arg.v.at(arg.c - 1);
+    if (lineArg.empty() or !zkb::IsInteger(lineArg) or zkb::Error::NonExistantLine(std::stoi(lineArg))) return;
+
+    const auto& dir = Dir::DirectoryInLine(std::stoi(lineArg));
+
+    std::cout << "Text: "         << Dir::GetDirectoryName(dir) << '\n';
+    std::cout << "Is directory: " << fs::is_directory(dir)      << '\n';
+    std::cout << "Empty: "        << fs::is_empty(dir)          << '\n';
+
+    if (recursive) ShowSubtreeStats(dir.path());
 }
 
 void
-CommandHandler::ShowStatus()
+CommandHandler::ShowSubtreeStats(const fs::path& block)
 {
-    std::cout << "Number of lines: " << Dir::GetNumberOfDirs() << '\n';
+    const auto stats = zkb::SubtreeStats::Of(block);
+
+    std::string output;
+    output += "Number of lines: "  + std::to_string(stats.ownLines) + '\n';
+    output += "Lines in subtree: " + std::to_string(stats.lines)    + '\n';
+    output += "Max depth: "        + std::to_string(stats.depth)    + '\n';
+
+    if (!stats.largest.empty())
+    {
+        output += "Largest blocks:\n";
+        for (const auto& largest : stats.largest)
+        {
+            output += "    " + std::to_string(largest.lines) + " lines\t" + largest.linePath + '\n';
+        }
+    }
+
+    zkb::Trace::Span span("output", "output");
+    std::cout.write(output.data(), output.size());
 }
 
 void
-CommandHandler::GetDirInfo()
+CommandHandler::ShowHelp()
 {
-    if (arg.c != 2)
+    const bool specific = arg.c > 1;
+    const auto* match   = specific? zkb::CommandTable::Find(arg.v.at(1)) : nullptr;
+    if (specific and match == nullptr)
     {
-        WrongUsage(Command::None);
+        std::cerr << "Unknown command " << arg.v.at(1) << '\n';
+        failed = true;
         return;
     }
 
-    const auto& dir = Dir::DirectoryInLine(std::stoi(arg.v.at(1)));
+    std::cout << '\n';
+    if (!specific)
+    {
+        std::cout << "Repeat\n    # command args... - Repeat a repeatable command # times.\n\n";
+    }
 
-    std::cout << "Text: "         << Dir::GetDirectoryName(dir) << '\n';
-    std::cout << "Is directory: " << fs::is_directory(dir)      << '\n';
-    std::cout << "Empty: "        << fs::is_empty(dir)          << std::endl;
+    for (const auto& spec : zkb::CommandTable::entries)
+    {
+        if (spec.usage.empty() or (specific and &spec != match)) continue;
+        std::cout << spec.usage << (spec.repeatable? "    (repeatable)\n\n" : "\n");
+    }
 }
 
 void 
 CommandHandler::ListCurrentDirectory()
 {
-    //Could make this faster
-    static std::ostringstream output;
-    // const auto start{std::chrono::steady_clock::now()};
-    std::cout << '\n';
-    switch (arg.c)
+    static constexpr std::string_view PREFIX = "\t\t\t\t";
+
+    //Built in one buffer and written once, reused between calls
+    static std::string output;
+    output.clear();
+    output += '\n';
+
+    auto streamOut = [&](std::string_view filename, bool selected)
+    {
+        output += PREFIX;
+        output += selected? "> " : "  ";
+        output += filename;
+        output += '\n';
+    };
+
+    const bool listAll = arg.c == 2 and arg.v.at(1) == "-a";
+    switch (listAll? 1 : arg.c)
     {
         case 1:
         {
-            if (fs::is_empty(basedPath))
+            if (forceCommand)
             {
-                std::cout << "\t\t\t\t> [New line]\n\t\t\t\tNumber of lines: 0" << '\n';
-                return;
-            }
+                //Unordered, straight from the directory
+                uint32_t numberOfLines = 0;
+                Dir::ForEachLine([&](const zkb::LineView& view)
+                {
+                    streamOut(view.filename, false);
+                    numberOfLines += 1;
+                });
 
-            if (true or updateDirectoriesList)
-            {
-                std::ostringstream().swap(output);
-                uint32_t lineNumber = 1;
+                output += PREFIX;
+                output += "Number of lines: " + std::to_string(numberOfLines) + '\n';
+                break;
+            }
 
-                auto streamOut = [&](auto dir)
-                {
-                    output << "\t\t\t\t";
-                    if (currentLine == lineNumber)
-                    {
-                        output << "> ";
-                    }
-                    else
-                    {
-                        output << "  ";
-                    }
+            const auto listing = zkb::BlockListing::Get();
+            const auto& lines  = *listing;
 
-                     output << dir.path().filename().string() << '\n';
-                };
+            if (lines.Empty())
+            {
+                output += PREFIX;
+                output += "> [New line]\n";
+                output += PREFIX;
+                output += "Number of lines: 0\n";
+                break;
+            }
 
-                for (const auto& dir : Dir::PathIterator())
-                {
-                    uint32_t dirLineNumber = Dir::GetDirectoryLineNumber(dir);
-                    if (dirLineNumber == lineNumber or forceCommand)
-                        streamOut(dir);
-                    else
-                    {
-                        for (const auto& dir : Dir::PathIterator())
-                        {
-                            uint32_t otherdirLineNumber = Dir::GetDirectoryLineNumber(dir);
-                            if (otherdirLineNumber == lineNumber)
-                            {
-                                streamOut(dir);
-                            }
-                        }
-                    }
-                    lineNumber += 1;
-                }
+            //Only a window around the current line unless "ls -a"
+            std::size_t first = 0;
+            std::size_t last  = lines.Size();
+            if (!listAll)
+            {
+                const std::size_t current = listing->LowerBound(currentLine);
+                first = current > LIST_WINDOW? current - LIST_WINDOW : 0;
+                last  = std::min<std::size_t>(lines.Size(), current + LIST_WINDOW + 1);
+            }
 
-                if (forceCommand)  output << "\t\t\t\t" << "Number of lines: " << Dir::GetNumberOfDirs();
+            if (first > 0)
+            {
+                output += PREFIX;
+                output += "  ... " + std::to_string(first) + " more above (ls -a)\n";
+            }
 
-                if (currentLine > Dir::GetNumberOfDirs())
-                {
-                    output << "\t\t\t\t> [New line]\n";
-                }
+            for (std::size_t i = first; i < last; i += 1)
+            {
+                streamOut(lines[i].filename, lines[i].lineNumber == currentLine);
+            }
 
-                updateDirectoriesList = false;
+            if (last < lines.Size())
+            {
+                output += PREFIX;
+                output += "  ... " + std::to_string(lines.Size() - last) + " more below (ls -a)\n";
             }
 
-            std::cout << output.str();
+            if (currentLine > lines.Size())
+            {
+                output += PREFIX;
+                output += "> [New line]\n";
+            }
         } break;
         case 2:
         {
@@ -1033,101 +1456,322 @@ CommandHandler::ListCurrentDirectory()
                 if (range.text.at(0) == "-1") return;
             }
 
+            const auto listing = zkb::BlockListing::Get();
             if (zkb::IsInteger(arg.v.at(1)))
             {
-                const auto& dir = Dir::DirectoryInLine(std::stoi(arg.v.at(1)));
-                std::cout << "\t\t\t\t" << dir.path().filename().string() << "\n";
+                const auto line = listing->Find(std::stoi(arg.v.at(1)));
+                if (!line)
+                {
+                    zkb::Error::NonExistantLine(std::stoi(arg.v.at(1)));
+                    return;
+                }
+                output += PREFIX;
+                output += line->filename;
+                output += '\n';
             }
             else
             {
                 bool notFound = true;
-                for (const auto& elem : Dir::PathIterator())
+                for (const auto line : *listing)
                 {
-                    const auto& name = Dir::GetDirectoryName(elem);
-                    if (name == finalText)
+                    if (line.Name() == arg.v.at(1))
                     {
-                        std::cout << "\t\t\t\t" << elem.path().filename().string() << '\n';
+                        output += PREFIX;
+                        output += line.filename;
+                        output += '\n';
                         notFound = false;
                     }
                 }
 
                 if (notFound)
                 {
-                    std::cout << "\t\t\t\tNo match\n";
+                    output += PREFIX;
+                    output += "No match\n";
                 }
             }
-
         } break;
         default:
         {
             std::cerr << arg.c << '\n';
             WrongUsage(Command::LS);
+            return;
         }
     }
-    std::cout << std::endl;
-    // const auto end{std::chrono::steady_clock::now()};
-    // const std::chrono::duration<double> elapsed_seconds{end - start};
-    // std::cout << "Took:" << elapsed_seconds.count() << " with forceCommand: " << forceCommand << std::endl;
+
+    output += '\n';
+
+    zkb::Trace::Span span("output", "output");
+    std::cout.write(output.data(), output.size());
 }
 
 void
-CommandHandler::ChangeDirectory()
+CommandHandler::ShowTree()
+{
+    uint32_t maxDepth = std::numeric_limits<uint32_t>::max();
+    if (arg.c == 2)
+    {
+        if (!zkb::IsInteger(arg.v.at(1)) or arg.v.at(1).empty())
+        {
+            WrongUsage(Command::Tree);
+            return;
+        }
+        maxDepth = std::stoi(arg.v.at(1));
+    }
+
+    std::cout << '\n' << "    " << basedPath.filename().string() << '\n';
+    if (maxDepth == 0) return;
+
+    /*
+     * Every line of this block is a separate job, and so is every block of a block with
+     * many of them, so one large line doesn't render serially. Outputs are written back
+     * in line order.
+     */
+    const auto listing = zkb::BlockListing::Get();
+    std::vector<std::future<zkb::RenderedTree>> subtrees;
+    subtrees.reserve(listing->Size());
+
+    for (const auto line : *listing)
+    {
+        subtrees.push_back(zkb::ThreadPool::Shared().Submit([path = basedPath / line.filename, maxDepth]()
+        {
+            zkb::RenderedTree out;
+            zkb::RenderTree(path, 1, maxDepth, out);
+            return out;
+        }));
+    }
+
+    std::string header;
+    for (std::size_t i = 0; i < subtrees.size(); i += 1)
+    {
+        header.assign("    |- ");
+        header += (*listing)[i].filename;
+        header += '\n';
+
+        auto out = subtrees[i].get();
+
+        zkb::Trace::Span span("output", "output");
+        std::cout.write(header.data(), header.size());
+        zkb::WriteTree(out, std::cout);
+        std::cout.flush();
+    }
+    std::cout << '\n';
+}
+
+void
+CommandHandler::FindLines()
+{
+    zkb::Search::Query query;
+
+    //Pattern may be a quoted string spanning several args
+    for (uint32_t i = 1; i < arg.c; i += 1)
+    {
+        if (arg.v.at(i).empty()) continue;
+        if (arg.v.at(i) == "-r")
+        {
+            query.regex = true;
+            continue;
+        }
+
+        if (!query.pattern.empty()) query.pattern += ' ';
+        query.pattern += arg.v.at(i);
+    }
+
+    if (query.pattern.size() >= 2 and query.pattern.starts_with('"') and query.pattern.ends_with('"'))
+    {
+        query.pattern = query.pattern.substr(1, query.pattern.size() - 2);
+    }
+
+    if (query.pattern.empty())
+    {
+        WrongUsage(Command::Find);
+        return;
+    }
+
+    std::vector<zkb::Search::Match> matches;
+    try
+    {
+        //Lines edited from outside the session since the last find
+        auto* index = zkb::TrigramIndex::Active();
+        if (index != nullptr) index->CheckTopLevel();
+        matches = index != nullptr? index->Find(query) : zkb::Search::Find(rootPath, query);
+    }
+    catch (const std::regex_error& error)
+    {
+        std::cerr << "Malformed regex: " << error.what() << '\n';
+        failed = true;
+        return;
+    }
+
+    std::string output = "\n";
+    for (const auto& match : matches)
+    {
+        output += "\t\t\t\t/";
+        output += match.linePath;
+        output += "  ";
+        output += match.text;
+        output += '\n';
+    }
+
+    output += "\t\t\t\t";
+    output += matches.empty()? "No match\n\n" : std::to_string(matches.size()) + " matches\n\n";
+
+    zkb::Trace::Span span("output", "output");
+    std::cout.write(output.data(), output.size());
+}
+
+void
+CommandHandler::HandleIndex()
+{
+    using Index = zkb::TrigramIndex;
+
+    const std::string option = arg.c == 2? arg.v.at(1) : "";
+    if (option == "build")
+    {
+        const auto start{std::chrono::steady_clock::now()};
+        const auto* index = Index::Create(rootPath);
+        const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+        std::cout << "Indexed " << index->NumberOfLines() << " lines in " << elapsed.count() << "s\n";
+    }
+    else if (option == "off")
+    {
+        Index::Remove(rootPath);
+        std::cout << "Index removed\n";
+    }
+    else if (option.empty())
+    {
+        const auto* index = Index::Active();
+        if (index == nullptr)
+        {
+            std::cout << "No index, use \"index build\" to create one\n";
+            return;
+        }
+        std::cout << "Index " << Index::FilePath(rootPath).string() << ": " << index->NumberOfLines() << " lines\n";
+    }
+    else
+    {
+        WrongUsage(Command::Index);
+    }
+}
+
+void
+CommandHandler::ShowCounters()
+{
+    if (arg.c == 2)
+    {
+        if (arg.v.at(1) != "reset")
+        {
+            WrongUsage(Command::Stats);
+            return;
+        }
+
+        zkb::Counters::Reset();
+        std::cout << "Counters reset\n";
+        return;
+    }
+
+    const auto report = zkb::Counters::Report();
+    std::cout.write(report.data(), report.size());
+}
+
+void
+CommandHandler::ShowMemory()
 {
-    auto& pathArg      = arg.v.at(1);
-    fs::path finalPath = ParsePath(pathArg);
+    auto report = zkb::Memory::Report();
+    report += "Undo entries: " + std::to_string(Dir::history.size()) + '\n';
+    std::cout.write(report.data(), report.size());
+}
+
+void
+CommandHandler::HandleStorage()
+{
+    const fs::path marker = rootPath / ".hybrid";
+    const bool     hybrid = Dir::HybridStorage();
+
+    const std::string option = arg.c == 2? arg.v.at(1) : "";
+    if (option.empty())
+    {
+        std::cout << (hybrid? "Hybrid: lines without children are files\n" : "Directories: every line is a directory\n");
+        return;
+    }
+    if (option != "hybrid" and option != "dirs")
+    {
+        WrongUsage(Command::Storage);
+        return;
+    }
+
+    const bool toHybrid = option == "hybrid";
+    if (toHybrid) std::ofstream{marker};
+    else          fs::remove(marker);
+
+    const uint32_t converted = Dir::ConvertStorage(rootPath, toHybrid);
+
+    //Conversions replace inodes all over the project
+    zkb::SubtreeStats::Invalidate();
+    if (auto* index = zkb::TrigramIndex::Active()) index->CheckModified();
+
+    std::cout << "Converted " << converted << " lines\n";
+}
 
+void
+CommandHandler::ChangeDirectory()
+{
+    std::string pathArg;
     switch (arg.c)
     {
         case 1:
         {
-            if (currentLine > Dir::GetNumberOfDirs())
-            {
-                return;
-            }
-
-            fs::current_path(Dir::DirectoryInLine(currentLine).path());
+            pathArg = std::to_string(currentLine);
         } break;
-        case 2:
+        default:
         {
-            if (zkb::IsInteger(arg.v.at(1)))
+            //A quoted line text may span several args
+            for (uint32_t i = 1; i < arg.c; i += 1)
             {
-                fs::current_path(Dir::DirectoryInLine(std::stoi(arg.v.at(1))));
-                break;
+                if (arg.v.at(i).empty()) continue;
+                if (!pathArg.empty()) pathArg += ' ';
+                pathArg += arg.v.at(i);
             }
 
-            // if (finalText.at(1) != ':' && !pathArg.starts_with('.'))
-            // {
-            //     std::cerr << "Path doesn't exist\n";
-            //     return;
-            // }
-
-            //TODO: Parse path to get the right directory. i.e ../test goes one back and the to test
-            // if (pathArg == "..")
-            // {
-            //     if (basedPath.string().ends_with(".zkb"))
-            //     {
-            //         std::cout << "Already at root directory\n";
-            //         return;
-            //     }
-            //     else
-            //     {
-            //         // path = basedPath.parent_path();
-            //         // break;
-            //     }
-            // }
-
-            // path = pathArg;
-            fs::current_path(finalText);
+            if (pathArg.size() >= 2 and pathArg.starts_with('"') and pathArg.ends_with('"'))
+            {
+                pathArg = pathArg.substr(1, pathArg.size() - 2);
+            }
         } break;
-        default: WrongUsage(Command::CD); return;
     }
 
-    // fs::current_path(path);
+    fs::path finalPath;
+    if (!ParsePath(pathArg, finalPath)) return;
+
+    //A leaf line stored as a file becomes a block on entering it, to get its first child
+    if (!Dir::PromoteLine(finalPath))
+    {
+        std::cerr << finalPath.filename().string() << " can't be opened as a block\n";
+        failed = true;
+        return;
+    }
+
+    //Resolved entirely from the listings, a single chdir
+    fs::current_path(finalPath);
+
+    //The block left goes back to being a file if it has no children
+    const auto descent = finalPath.lexically_relative(basedPath);
+    if (basedPath != rootPath and !descent.empty() and *descent.begin() == ".." and Dir::HybridStorage())
+    {
+        Dir::DemoteLine(basedPath);
+    }
+
     Dir::updateNumberOfDirs = true;
-    basedPath   = fs::current_path();
+    basedPath   = std::move(finalPath);
     currentLine = 1;
 }
 
+void
+CommandHandler::CleanCurrentDirectory()
+{
+    Dir::RecursivelyDelete(fs::directory_entry(fs::current_path()), false);
+}
+
 void CommandHandler::DebugRefresh()
 {
     // uint32_t lineOfNonexistantDir = 0;
@@ -1289,171 +1933,67 @@ CommandHandler::ParseRange(std::string& lineNumberArg, Command command)
     return true;
 }
 
-//TODO: Finish this
+/**
+ * Segments are separated by '/': a line number, the text of a line, ".." or ".".
+ * A leading '/' starts from the project root: "2/1/3", "../4", "/", "/2/main() [int]"
+ */
 bool
-CommandHandler::ParsePath(const std::string& rawPath)
+CommandHandler::ParsePath(const std::string& rawPath, fs::path& resolved)
 {
-    fs::path iterationPath = basedPath;
-    std::vector<std::function<void()>> executionList;
-    executionList.reserve(8);
+    std::string_view remaining = rawPath;
 
-    auto oneBack = [iterationPath]() mutable
+    resolved = rawPath.starts_with('/')? rootPath : basedPath;
+    while (!remaining.empty())
     {
-        iterationPath = iterationPath.parent_path();
-    };
+        const auto slash   = remaining.find('/');
+        const auto segment = remaining.substr(0, slash);
+        remaining.remove_prefix(slash == std::string_view::npos? remaining.size() : slash + 1);
 
-    for (uint32_t i = 0; i < rawPath.length(); i += 1)
-    {
-        const auto& c = rawPath.at(i);
-        if (c == '/')
-        {
-            continue;
-        }
+        if (segment.empty() or segment == ".") continue;
 
-        if (rawPath.substr(i, 3) == "../")
+        if (segment == "..")
         {
-            iterationPath = iterationPath.parent_path();
-        }
-        else if (std::isdigit(c))
-        {
-            auto directoryNumber = rawPath.substr(i, rawPath.find('/', i));
-            if (!zkb::IsInteger(directoryNumber))
+            if (resolved == rootPath)
             {
-                std::cout << "Can't find path\n";
+                std::cerr << "Already at root directory\n";
+                failed = true;
                 return false;
             }
+            resolved = resolved.parent_path();
+            continue;
+        }
+
+        const auto listing = zkb::BlockListing::Get(resolved);
+        std::optional<zkb::BlockListing::Line> line;
+
+        uint32_t lineNumber;
+        auto [ptr, err] = std::from_chars(segment.data(), segment.data() + segment.size(), lineNumber);
+        if (err == std::errc{} and ptr == segment.data() + segment.size())
+        {
+            line = listing->Find(lineNumber);
         }
         else
         {
-            std::cout << "Malformed path\n";
-            return false;
+            line = listing->FindName(segment);
         }
 
-    }
-}
-
-/*
- * TODO:
- * Change function args to Directory class instead of directory entry and line size
- */
-void
-CommandHandler::RangedDirectoryIteration(std::function<void(const std::filesystem::directory_entry&, uint32_t)> func)
-{
-    const auto& lowerBound = range.num.at(0);
-    const auto& upperBound = range.num.at(1);
-
-    bool equal = lowerBound == upperBound;
-
-    for (const auto& elem : fs::directory_iterator{basedPath})
-    {
-        if (!fs::is_directory(elem)) continue;
-
-        uint32_t dirLineNumber = Dir::GetDirectoryLineNumber(elem);
-        if (dirLineNumber >= lowerBound && dirLineNumber <= upperBound)
+        if (!line)
         {
-            func(elem, dirLineNumber);
+            std::cerr << "Can't find " << segment << " in " << resolved.filename().string() << '\n';
+            failed = true;
+            return false;
         }
+        resolved /= line->filename;
     }
-}
-void
-CommandHandler::GenericDirectoryIteration(std::function<void(zkb::Directory)> func)
-{
-    for (const auto& elem : Dir::PathIterator())
-    {
-        if (!fs::is_directory(elem)) continue;
-        func(elem);
-    }
+    return true;
 }
 
 #if DEBUG_BUILD
-void 
-CommandHandler::Benchmark(Command command, const std::array<std::string, 4>& arr)
+void
+CommandHandler::DebugBuild()
 {
-    if (arg.v.at(1) == "commands")
-    {
-        std::cout << '\n' <<
-            "Line = "   << (int)Command::Line   << '\n' <<
-            "Delete = " << (int)Command::Delete << '\n' <<
-            "Move = "   << (int)Command::Move   << '\n' <<
-            "List = "   << (int)Command::LS     << '\n' <<
-            "CD   = "   << (int)Command::CD     << "\n\n"
-            ;
-    }
-
-
-    const auto& timesToRepeat = arr.at(0);
-    const auto& numberOfLines = arr.at(1);
-
-    switch (command)
-    {
-        case Command::Line:
-        {
-            std::vector<double> markings;
-            markings.reserve(std::stoi(timesToRepeat));
-            for (uint32_t i = 0; i < std::stoi(timesToRepeat); i += 1)
-            {
-                arg.c = 3;
-                arg.v.at(0) = numberOfLines;
-                arg.v.at(1) = "l";
-                arg.v.at(2) = "test";
-
-                const auto start{std::chrono::steady_clock::now()};
-                Handle();
-                const auto end{std::chrono::steady_clock::now()};
-                const std::chrono::duration<double> elapsed_seconds{end - start};
-                markings.push_back(elapsed_seconds.count());
-
-                arg.c = 2;
-                arg.v.at(0) = "-d";
-                arg.v.at(1) = "(,)";
-                HandleLineDelete();
-            }
-        } break;
-        case Command::LS:
-        {
-            arg.c = 1;
-            arg.v.at(0) = "ls";
-
-            std::vector<double> markings;
-            std::vector<double> secondMarkings;
-            markings.reserve(std::stoi(timesToRepeat));
-            for (uint32_t i = 0; i < 2; i += 1)
-            {
-                for (uint32_t j = 0; j < std::stoi(timesToRepeat); j += 1)
-                {
-                    const auto start{std::chrono::steady_clock::now()};
-                    Handle();
-                    const auto end{std::chrono::steady_clock::now()};
-                    const std::chrono::duration<double> elapsed_seconds{end - start};
-                    if (i == 0)
-                        markings.push_back(elapsed_seconds.count());
-                    else
-                        secondMarkings.push_back(elapsed_seconds.count());
-                }
-                arg.v.at(0) = "-ls";
-            };
-
-            double average = 0;
-            for (const auto& elem : markings)
-            {
-                average += elem;
-            }
-            average /= std::stoi(timesToRepeat);
-
-            double secondAverage = 0;
-            for (const auto& elem : secondMarkings)
-            {
-                secondAverage += elem;
-            }
-            secondAverage /= std::stoi(timesToRepeat);
-
-            std::cerr << "Average time took ordered: " << average << '\n';
-            std::cerr << "Average time took unordered: " << secondAverage << '\n';
-        } break;
-        default:
-        {
-        } break;
-    }
+    std::system("b");
+    Application::Exit();
 }
 #endif
 
@@ -0,0 +1,108 @@
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "CommandTable.hpp"
+#include "Counters.hpp"
+
+using Counters = zkb::Counters;
+
+std::array<Counters::PerCommand, Counters::COMMANDS> Counters::table   = {};
+std::atomic<uint32_t>                                Counters::current = static_cast<uint32_t>(Command::None);
+
+Counters::Scope::Scope(Command command) :
+    previous(current.load(std::memory_order_relaxed)),
+    command(static_cast<uint32_t>(command)),
+    start(std::chrono::steady_clock::now())
+{
+    current.store(this->command, std::memory_order_relaxed);
+}
+
+Counters::Scope::~Scope()
+{
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    const uint32_t bucket = std::min<uint32_t>(std::bit_width(static_cast<uint64_t>(micros)), LATENCY_BUCKETS - 1);
+
+    auto& entry = table[command];
+    entry.latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    entry.runs.fetch_add(1, std::memory_order_relaxed);
+    entry.micros.fetch_add(micros, std::memory_order_relaxed);
+
+    current.store(previous, std::memory_order_relaxed);
+}
+
+void
+Counters::Reset()
+{
+    for (auto& entry : table)
+    {
+        for (auto& count : entry.counts)   count.store(0, std::memory_order_relaxed);
+        for (auto& count : entry.latency)  count.store(0, std::memory_order_relaxed);
+        entry.runs.store(0, std::memory_order_relaxed);
+        entry.micros.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string
+Counters::Report()
+{
+    //Upper bound of the bucket holding the pth percentile run
+    const auto percentile = [](const PerCommand& entry, uint64_t runs, double p) -> uint64_t
+    {
+        const auto rank = static_cast<uint64_t>(p * runs + 0.999999);
+
+        uint64_t seen = 0;
+        for (uint32_t bucket = 0; bucket < LATENCY_BUCKETS; bucket += 1)
+        {
+            seen += entry.latency[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank) return uint64_t{1} << bucket;
+        }
+        return uint64_t{1} << (LATENCY_BUCKETS - 1);
+    };
+
+    std::string out;
+    char        row[256];
+
+    std::snprintf(row, sizeof(row), "%-8s %7s %10s %10s %10s", "command", "runs", "mean_us", "p50_us<=", "p99_us<=");
+    out += row;
+    for (const auto& name : names)
+    {
+        std::snprintf(row, sizeof(row), " %10.*s", static_cast<int>(name.size()), name.data());
+        out += row;
+    }
+    out += '\n';
+
+    for (uint32_t command = 0; command < COMMANDS; command += 1)
+    {
+        const auto&    entry = table[command];
+        const uint64_t runs  = entry.runs.load(std::memory_order_relaxed);
+
+        bool used = runs != 0;
+        for (const auto& count : entry.counts) used = used or count.load(std::memory_order_relaxed) != 0;
+        if (!used) continue;
+
+        const auto* spec = CommandTable::Find(static_cast<Command>(command));
+        const auto  name = spec != nullptr? spec->aliases[0] : std::string_view("other");
+
+        std::snprintf(row, sizeof(row), "%-8.*s %7llu %10.1f %10llu %10llu",
+            static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(runs),
+            runs != 0? static_cast<double>(entry.micros.load(std::memory_order_relaxed)) / runs : 0.0,
+            static_cast<unsigned long long>(runs != 0? percentile(entry, runs, 0.50) : 0),
+            static_cast<unsigned long long>(runs != 0? percentile(entry, runs, 0.99) : 0));
+        out += row;
+
+        for (const auto& count : entry.counts)
+        {
+            std::snprintf(row, sizeof(row), " %10llu", static_cast<unsigned long long>(count.load(std::memory_order_relaxed)));
+            out += row;
+        }
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,237 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "CommandHandler.hpp"
+#include "Daemon.hpp"
+#include "ProjectIO.hpp"
+#include "TrigramIndex.hpp"
+
+namespace fs = zkb::fs;
+
+namespace
+{
+    //Ends every response, after the command's output: '\0' then "ok" or "error"
+    constexpr char STATUS_MARK = '\0';
+
+    bool Address(const fs::path& path, sockaddr_un& address)
+    {
+        address = {};
+        address.sun_family = AF_UNIX;
+
+        const auto& native = path.native();
+        if (native.size() >= sizeof(address.sun_path)) return false;
+
+        std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+        return true;
+    }
+
+    int Connect(const fs::path& path)
+    {
+        sockaddr_un address;
+        if (!Address(path, address)) return -1;
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool WriteAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            //A client that went away must not kill the daemon with SIGPIPE
+            const auto written = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data.remove_prefix(written);
+        }
+        return true;
+    }
+
+    std::string ReadAll(int fd)
+    {
+        std::string data;
+        char        buffer[1 << 14];
+        while (true)
+        {
+            const auto bytes = read(fd, buffer, sizeof(buffer));
+            if (bytes < 0 and errno == EINTR) continue;
+            if (bytes <= 0) break;
+            data.append(buffer, bytes);
+        }
+        return data;
+    }
+
+    /*
+     * Runs one request with std::cout/std::cerr going to the response and an empty std::cin.
+     * Errors escaping the command are reported to the client, the daemon keeps serving.
+     */
+    std::string Process(CommandHandler& handler, const std::string& request, bool& quit)
+    {
+        const auto newline = request.find('\n');
+        const auto cwd     = request.substr(0, newline);
+        auto       command = newline == std::string::npos? std::string() : request.substr(newline + 1);
+        while (!command.empty() and (command.back() == '\n' or command.back() == '\r')) command.pop_back();
+
+        std::ostringstream output;
+        std::istringstream input;
+
+        auto* coutBuffer = std::cout.rdbuf(output.rdbuf());
+        auto* cerrBuffer = std::cerr.rdbuf(output.rdbuf());
+        auto* cinBuffer  = std::cin.rdbuf(input.rdbuf());
+
+        bool success = false;
+        try
+        {
+            if (handler.ChangeBlock(cwd))
+            {
+                quit    = handler.Execute(std::move(command));
+                success = !CommandHandler::failed;
+            }
+        }
+        catch (const std::exception& error)
+        {
+            output << "Error: " << error.what() << '\n';
+        }
+
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        std::cin.rdbuf(cinBuffer);
+        std::cin.clear();
+
+        auto response = std::move(output).str();
+        response += STATUS_MARK;
+        response += success? "ok" : "error";
+        return response;
+    }
+}
+
+fs::path
+zkb::Daemon::SocketPath(const fs::path& root)
+{
+    auto path = root.parent_path() / (root.filename().string() + ".sock");
+
+    //sun_path is around 108 bytes, long project paths get a socket in the temp directory
+    sockaddr_un address;
+    if (!Address(path, address))
+    {
+        path = fs::temp_directory_path() / ("zkb-" + std::to_string(std::hash<std::string>{}(root.native())) + ".sock");
+    }
+    return path;
+}
+
+int
+zkb::Daemon::Serve()
+{
+    CommandHandler handler(false);
+    if (!handler.SetupRoot()) return EXIT_FAILURE;
+    handler.showPrompt = false;
+
+    const auto path = SocketPath(CommandHandler::rootPath);
+    if (const int running = Connect(path); running >= 0)
+    {
+        close(running);
+        std::cerr << "A daemon is already running on " << path.string() << '\n';
+        return EXIT_FAILURE;
+    }
+    unlink(path.c_str());
+
+    sockaddr_un address;
+    Address(path, address);
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 or bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 or listen(server, 16) != 0)
+    {
+        std::cerr << "Can't listen on " << path.string() << ": " << std::strerror(errno) << '\n';
+        if (server >= 0) close(server);
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Serving " << CommandHandler::rootPath.string() << " on " << path.string() << std::endl;
+
+    bool quit = false;
+    while (!quit)
+    {
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        const auto request  = ReadAll(client);
+        if (request.empty())
+        {
+            //Liveness probe from another "zkb daemon"
+            close(client);
+            continue;
+        }
+
+        const auto response = Process(handler, request, quit);
+        WriteAll(client, response);
+        close(client);
+    }
+
+    close(server);
+    unlink(path.c_str());
+    zkb::TrigramIndex::FlushActive();
+    return EXIT_SUCCESS;
+}
+
+int
+zkb::Daemon::Send(const std::string& command)
+{
+    const auto cwd  = fs::current_path();
+    const auto root = ProjectIO::FindRoot(cwd);
+    if (root.empty())
+    {
+        CommandHandler::WrongUsage(CommandHandler::Setup::RootDirectory);
+        return EXIT_FAILURE;
+    }
+
+    const auto path = SocketPath(root);
+    const int  fd   = Connect(path);
+    if (fd < 0)
+    {
+        std::cerr << "No daemon running for " << root.string() << ", start one with \"zkb daemon\"\n";
+        return EXIT_FAILURE;
+    }
+
+    const bool sent = WriteAll(fd, cwd.native() + '\n' + command + '\n');
+    shutdown(fd, SHUT_WR);
+
+    const auto response = sent? ReadAll(fd) : std::string();
+    close(fd);
+
+    //A response without status means the daemon died running the command
+    const auto mark = response.rfind(STATUS_MARK);
+    if (mark == std::string::npos)
+    {
+        std::cout.write(response.data(), response.size());
+        std::cerr << "The daemon stopped without answering\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout.write(response.data(), mark);
+    return std::string_view(response).substr(mark + 1) == "ok"? EXIT_SUCCESS : EXIT_FAILURE;
+}
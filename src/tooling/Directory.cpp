@@ -1,19 +1,178 @@
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <span>
 #include <stack>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Directory.hpp"
 #include "CommandHandler.hpp"
+#include "Counters.hpp"
+#include "Memory.hpp"
+#include "Trace.hpp"
 
 using Directory = zkb::Directory;
+using BlockScan = zkb::BlockScan;
 namespace fs = zkb::fs;
 
 std::stack<CommandHandler::HistoryT> Directory::history = {};
 
+namespace
+{
+    //One buffer per nesting level so scans inside scan callbacks don't clobber each other
+    thread_local std::vector<std::unique_ptr<std::string>> scanBuffers;
+    thread_local std::size_t                               scanDepth = 0;
+}
+
+BlockScan::BlockScan(const fs::path& path)
+{
+    Memory::Scope memory(Memory::Listings);
+
+    if (scanDepth == scanBuffers.size())
+    {
+        scanBuffers.push_back(std::make_unique<std::string>());
+    }
+    buffer = scanBuffers[scanDepth++].get();
+    buffer->clear();
+
+    Trace::Span span("scan", "fs");
+    span.Arg("path", path.native());
+
+    handle = opendir(path.c_str());
+    if (handle == nullptr) return;
+
+    uint64_t entries = 0;
+    const int fd = dirfd(handle);
+    while (const dirent* entry = readdir(handle))
+    {
+        entries += 1;
+
+        const std::string_view name = entry->d_name;
+        if (name == "." or name == "..") continue;
+
+        //Leaf lines may be regular files under hybrid storage
+        bool isDirectory = entry->d_type == DT_DIR;
+        bool isFile      = entry->d_type == DT_REG;
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (fstatat(fd, entry->d_name, &st, 0) != 0) continue;
+            isDirectory = S_ISDIR(st.st_mode);
+            isFile      = S_ISREG(st.st_mode);
+        }
+        if (!isDirectory and !isFile) continue;
+
+        const uint64_t inode = entry->d_ino;
+        buffer->append(reinterpret_cast<const char*>(&inode), sizeof(inode));
+        buffer->push_back(isDirectory);
+        buffer->append(name);
+        buffer->push_back('\0');
+    }
+
+    Counters::Add(Counters::Scans);
+    Counters::Add(Counters::Entries, entries);
+    span.Arg("entries", entries);
+}
+
+BlockScan::~BlockScan()
+{
+    if (handle != nullptr) closedir(handle);
+    scanDepth -= 1;
+}
+
+std::string_view
+BlockScan::Names() const
+{
+    return *buffer;
+}
+
+int
+BlockScan::Fd() const
+{
+    return dirfd(handle);
+}
+
+bool
+BlockScan::IsOpen() const
+{
+    return handle != nullptr;
+}
+
+bool
+Directory::ShiftLines(const fs::path& block, uint32_t from, int32_t offset)
+{
+    if (offset == 0) return true;
+
+    struct Shift
+    {
+        uint32_t lineNumber;
+        LineView view;
+    };
+
+    bool success = true;
+    BlockScan scan(block);
+    if (!scan.IsOpen()) return false;
+
+    //Views point into the scan buffer, which stays alive until the end of the function
+    std::vector<Shift> shifts;
+    ForEachLine([&](const LineView& view)
+    {
+        if (view.lineNumber >= from) shifts.push_back({view.lineNumber, view});
+    }, scan);
+
+    Trace::Span span("renames", "fs");
+    span.Arg("lines", shifts.size());
+
+    std::sort(shifts.begin(), shifts.end(), [offset](const Shift& a, const Shift& b)
+    {
+        return offset > 0? a.lineNumber > b.lineNumber : a.lineNumber < b.lineNumber;
+    });
+
+    for (const auto& shift : shifts)
+    {
+        success = RenameLine(shift.view, shift.lineNumber + offset) and success;
+    }
+    return success;
+}
+
+bool
+Directory::RenameLine(const LineView& view, uint32_t lineNumber)
+{
+    return RenameLine(view, lineNumber, view.name);
+}
+
+bool
+Directory::RenameLine(const LineView& view, uint32_t lineNumber, std::string_view name)
+{
+    std::array<char, NAME_MAX + 1> newName;
+
+    auto [end, err] = std::to_chars(newName.data(), newName.data() + newName.size(), lineNumber);
+    if (err != std::errc{} or name.size() + 2 > static_cast<std::size_t>(newName.data() + newName.size() - end))
+    {
+        std::cerr << "Line name too long: " << name << '\n';
+        CommandHandler::failed = true;
+        return false;
+    }
+
+    *end++ = ' ';
+    end    = std::copy(name.begin(), name.end(), end);
+    *end   = '\0';
+
+    Counters::Add(Counters::Renames);
+    return renameat(view.dirfd, view.filename.data(), view.dirfd, newName.data()) == 0;
+}
+
 Directory::Directory() {};
 
 Directory::Directory(fs::directory_entry dirEntry) :
@@ -91,38 +250,26 @@ Directory::IsInitialized() const
 
 auto Directory::DirectoryInLine(uint32_t lineNumber, std::span<const char*> namesToAvoid) -> fs::directory_entry
 {
-    fs::directory_entry dirInLine;
-    for (const auto& elem : PathIterator())
+    fs::path dirInLine;
+    ForEachLine([&](const LineView& view)
     {
-        if (!elem.is_directory()) break;
+        if (view.lineNumber != lineNumber) return true;
         for (const auto& nameToAvoid : namesToAvoid)
         {
-            if (GetDirectoryName(elem) == nameToAvoid)
-            {
-                continue;
-            }
+            if (view.name == nameToAvoid) return true;
         }
 
-        if (GetDirectoryLineNumber(elem) == lineNumber)
-        {
-            const auto name = GetDirectoryName(elem);
-            if (name.ends_with("temp"))
-            {
-                return elem;
-            }
-            else
-            {
-                dirInLine = elem;
-            }
-        }
-    }
+        dirInLine = CommandHandler::basedPath / view.filename;
+        return !view.name.ends_with("temp");
+    });
 
-    if (dirInLine.exists())
-        return dirInLine;
+    if (!dirInLine.empty())
+        return fs::directory_entry(std::move(dirInLine));
 
     std::cerr << "Acessing non-existant line number " << lineNumber <<
     " in "  << fs::current_path().string() << "\nThis path has "    << 
     GetNumberOfDirs() << " directories.\n";
+    CommandHandler::failed = true;
 
     return fs::directory_entry{"null"};
 }
@@ -133,33 +280,33 @@ Directory::DirectoriesInLines(const std::pair<uint32_t, uint32_t>& lines)
     const auto& firstLine  = lines.first;
     const auto& secondLine = lines.second;
 
-    fs::directory_entry first;
-    fs::directory_entry second;
+    fs::path first;
+    fs::path second;
 
-    for (auto& elem : PathIterator())
+    ForEachLine([&](const LineView& view)
     {
-        if (!elem.is_directory()) break;
-
-        uint32_t dirLineNumber = GetDirectoryLineNumber(elem);
-        if (dirLineNumber == firstLine)
+        if (view.lineNumber == firstLine)
         {
-            first = std::move(elem);
+            first = CommandHandler::basedPath / view.filename;
         }
 
-        if (dirLineNumber == secondLine)
+        if (view.lineNumber == secondLine)
         {
-            second = std::move(elem);
+            second = CommandHandler::basedPath / view.filename;
         }
 
-        if (first.exists() and second.exists())
-        {
-            return std::make_pair(std::move(first), std::move(second));
-        }
+        return first.empty() or second.empty();
+    });
+
+    if (!first.empty() and !second.empty())
+    {
+        return std::make_pair(fs::directory_entry(std::move(first)), fs::directory_entry(std::move(second)));
     }
 
-    std::cerr << "Acessing non-existant line numbers " << first <<
+    std::cerr << "Acessing non-existant line numbers " << firstLine << ", " << secondLine <<
     " in "  << fs::current_path().string() << "\nThis path has "    << 
     GetNumberOfDirs() << " directories.\n";
+    CommandHandler::failed = true;
 
     return {fs::directory_entry{"null"}, fs::directory_entry{"null"}};
 }
@@ -170,16 +317,13 @@ Directory::DirectoriesInRange(uint32_t lowerBound, uint32_t upperBound)
     std::vector<fs::directory_entry> dirs;
     dirs.reserve(upperBound - lowerBound + 1);
 
-    for (auto& elem : PathIterator())
+    ForEachLine([&](const LineView& view)
     {
-        if (!elem.is_directory()) break;
-
-        uint32_t dirLineNumber = GetDirectoryLineNumber(elem);
-        if (dirLineNumber >= lowerBound and dirLineNumber <= upperBound)
+        if (view.lineNumber >= lowerBound and view.lineNumber <= upperBound)
         {
-            dirs.emplace_back(std::move(elem));
+            dirs.emplace_back(CommandHandler::basedPath / view.filename);
         }
-    }
+    });
 
     return dirs;
 }
@@ -187,18 +331,93 @@ Directory::DirectoriesInRange(uint32_t lowerBound, uint32_t upperBound)
 bool
 Directory::CreateDirectory(const std::string& name, const fs::path& path)
 {
-    const fs::path _path = path.string() + '\\' + name;
-    std::cerr << "Creating " << name /*<< " as " << _path.string()*/ << "\n\n";
+    const fs::path _path = path / name;
+    if constexpr (DEBUG_BUILD)
+    {
+        std::cerr << "Creating " << name /*<< " as " << _path.string()*/ << "\n\n";
+    }
     numberOfDirs += 1;
+    Counters::Add(Counters::Mkdirs);
+
+    if (HybridStorage())
+    {
+        const int fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        close(fd);
+        return true;
+    }
     return fs::create_directory(_path);
 }
 
+bool
+Directory::HybridStorage(const fs::path& root)
+{
+    struct stat st;
+    return stat((root / ".hybrid").c_str(), &st) == 0;
+}
+
+bool
+Directory::PromoteLine(const fs::path& line)
+{
+    struct stat st;
+    if (stat(line.c_str(), &st) != 0) return false;
+    if (S_ISDIR(st.st_mode)) return true;
+
+    //Leaf files are empty, nothing is lost replacing them
+    if (!S_ISREG(st.st_mode) or st.st_size != 0) return false;
+
+    Counters::Add(Counters::Removes);
+    Counters::Add(Counters::Mkdirs);
+    return unlink(line.c_str()) == 0 and mkdir(line.c_str(), 0755) == 0;
+}
+
+uint32_t
+Directory::ConvertStorage(const fs::path& block, bool hybrid)
+{
+    uint32_t converted = 0;
+
+    BlockScan scan(block);
+    ForEachLine([&](const LineView& view)
+    {
+        const fs::path line = block / view.filename;
+        if (view.isBlock)
+        {
+            converted += ConvertStorage(line, hybrid);
+
+            //The current block stays a directory, it is the process cwd
+            if (hybrid and line != CommandHandler::basedPath and DemoteLine(line)) converted += 1;
+        }
+        else if (!hybrid and PromoteLine(line))
+        {
+            converted += 1;
+        }
+    }, scan);
+
+    return converted;
+}
+
+bool
+Directory::DemoteLine(const fs::path& line)
+{
+    //rmdir only succeeds on an empty directory
+    if (rmdir(line.c_str()) != 0) return false;
+
+    Counters::Add(Counters::Removes);
+    Counters::Add(Counters::Mkdirs);
+
+    const int fd = open(line.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    close(fd);
+    return true;
+}
+
 bool
 Directory::RemoveDirectory(const fs::directory_entry& dir)
 {
     const auto& lineNumber = std::to_string(GetDirectoryLineNumber(dir));
     auto filename   = GetDirectoryName(dir);
 
+    Memory::Scope memory(Memory::History);
     history.push(CommandHandler::HistoryT
         {
             {{"l", filename, lineNumber}, 3},
@@ -207,21 +426,28 @@ Directory::RemoveDirectory(const fs::directory_entry& dir)
     );
 
     numberOfDirs -= 1;
+    Counters::Add(Counters::Removes);
     return fs::remove(dir);
 }
 
 void
 Directory::RecursivelyDelete(const fs::directory_entry& dir, bool save)
 {
+    Trace::Span span("delete", "fs");
+
     auto Delete = [dir]()
     {
         const auto& lineNumber = std::to_string(GetDirectoryLineNumber(dir));
         const auto& filename   = GetDirectoryName(dir);
 
-        std::cerr << "Pushing " << dir.path() << '\n';
-        std::cerr << "remove " << dir.path().string() << "\n";
-        std::cerr << "My parent: " << dir.path().parent_path() << "\n\n";
+        if constexpr (DEBUG_BUILD)
+        {
+            std::cerr << "Pushing " << dir.path() << '\n';
+            std::cerr << "remove " << dir.path().string() << "\n";
+            std::cerr << "My parent: " << dir.path().parent_path() << "\n\n";
+        }
 
+        Memory::Scope memory(Memory::History);
         history.push(CommandHandler::HistoryT
             {
                 {{"l", filename, lineNumber}, 3},
@@ -230,6 +456,7 @@ Directory::RecursivelyDelete(const fs::directory_entry& dir, bool save)
         );
 
         numberOfDirs -= 1;
+        Counters::Add(Counters::Removes);
         fs::remove(dir);
     };
 
@@ -242,14 +469,24 @@ Directory::RecursivelyDelete(const fs::directory_entry& dir, bool save)
         else
         {
             numberOfDirs -= 1;
+            Counters::Add(Counters::Removes);
             fs::remove(dir);
         }
         return;
     }
     
-    for (const auto& elem : fs::recursive_directory_iterator{dir})
+    /*
+     * Children first, collected before deleting since a block can't be iterated while it
+     * changes. Last line first, so undo pops them back in line order.
+     */
+    std::vector<fs::directory_entry> children(fs::directory_iterator{dir}, fs::directory_iterator{});
+    std::sort(children.begin(), children.end(), [](const fs::directory_entry& a, const fs::directory_entry& b)
     {
-        RecursivelyDelete(elem);
+        return GetDirectoryLineNumber(a) > GetDirectoryLineNumber(b);
+    });
+    for (const auto& child : children)
+    {
+        RecursivelyDelete(child, save);
     }
 
     //Delete parent
@@ -260,10 +497,21 @@ Directory::RecursivelyDelete(const fs::directory_entry& dir, bool save)
     else
     {
         numberOfDirs -= 1;
+        Counters::Add(Counters::Removes);
         fs::remove(dir);
     }
 }
 
+void
+Directory::RemoveSubtree(const fs::directory_entry& dir)
+{
+    Trace::Span span("delete", "fs");
+
+    numberOfDirs -= 1;
+    Counters::Add(Counters::Removes);
+    fs::remove_all(dir);
+}
+
 bool     Directory::updateNumberOfDirs = true;
 uint32_t Directory::numberOfDirs       = 0;
 
@@ -274,10 +522,7 @@ Directory::GetNumberOfDirs()
     {
         // std::cerr << "Updating number of dirs\n";
         numberOfDirs = 0;
-        for (const auto& elem : PathIterator())
-        {
-            if (elem.is_directory()) numberOfDirs += 1;
-        }
+        ForEachLine([](const LineView&) { numberOfDirs += 1; });
         updateNumberOfDirs = false;
     }
 
@@ -301,10 +546,10 @@ Directory::GetDirectoryName(const fs::path& path)
 }
 
 fs::directory_entry
-Directory::ChangeDirectoryLineNumber(const fs::directory_entry& elem, uint32_t number, bool ignoreError)
+Directory::ChangeDirectoryLineNumber(const fs::directory_entry& elem, uint32_t number, [[maybe_unused]] bool ignoreError)
 {
     auto fullDirName = std::to_string(number) + ' ' + GetDirectoryName(elem.path());
-    auto path        = CommandHandler::basedPath.string() + "\\" + fullDirName;
+    auto path        = elem.path().parent_path() / fullDirName;
     
     // if (ignoreError)
     // {
@@ -313,6 +558,7 @@ Directory::ChangeDirectoryLineNumber(const fs::directory_entry& elem, uint32_t n
     // }
     // else
     // {
+        Counters::Add(Counters::Renames);
         fs::rename(elem, path, err);
         // std::cout << err.message() << '\n';
     // }
@@ -323,8 +569,9 @@ fs::directory_entry
 Directory::ChangeDirectoryName(const fs::directory_entry& elem, const std::string& newName)
 {
     auto fullDirName = std::to_string(GetDirectoryLineNumber(elem)) + ' ' + newName;
-    auto path        = CommandHandler::basedPath.string() + "\\" + fullDirName;
+    auto path        = elem.path().parent_path() / fullDirName;
     
+    Counters::Add(Counters::Renames);
     fs::rename(elem, path);
     return fs::directory_entry(std::move(path));
 }
@@ -332,8 +579,9 @@ Directory::ChangeDirectoryName(const fs::directory_entry& elem, const std::strin
 fs::directory_entry
 Directory::ChangeDirectoryFilename(const fs::directory_entry& elem, const std::string& newName)
 {
-    auto path = elem.path().parent_path().string() + "\\" + newName;
+    auto path = elem.path().parent_path() / newName;
     
+    Counters::Add(Counters::Renames);
     fs::rename(elem, path);
     return fs::directory_entry(std::move(path));
 }
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Generator.hpp"
+
+namespace Generator = zkb::Generator;
+using LineTree = zkb::ProjectIO::LineTree;
+
+namespace
+{
+    //Room for "4294967295 " in a NAME_MAX filename
+    constexpr uint32_t MAX_TEXT = NAME_MAX - 11;
+
+    constexpr std::string_view WORDS[]
+    {
+        "if", "else", "while", "for", "return", "print", "int", "bool", "main", "num",
+        "value", "count", "index", "list", "map", "node", "next", "left", "right", "data",
+        "x", "y", "a", "b", "0", "1", "2", "==", "+", "-", "*", "%", "(", ")", "[", "]",
+    };
+
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : engine(seed) {}
+
+        //[0, n)
+        uint32_t Below(uint32_t n)
+        {
+            return static_cast<uint32_t>(engine() % n);
+        }
+
+        //[0, 1)
+        double Unit()
+        {
+            return (engine() >> 11) * 0x1.0p-53;
+        }
+
+        //Irwin-Hall with 4 terms: mean 0, standard deviation 1/sqrt(3)
+        double Normal()
+        {
+            return Unit() + Unit() + Unit() + Unit() - 2.0;
+        }
+
+    private:
+        std::mt19937_64 engine;
+    };
+
+    struct Shape
+    {
+        uint32_t              depth;
+        std::vector<uint32_t> children;
+    };
+
+    void Text(Random& random, const Generator::Options& options, std::string& out)
+    {
+        const uint32_t maxLength = std::clamp(options.maxLength, 1u, MAX_TEXT);
+        const double   spread    = options.meanLength * 0.866; //Normal() * sqrt(3) / 2 * mean
+        const auto     length    = static_cast<uint32_t>(std::clamp(
+            options.meanLength + random.Normal() * spread, 1.0, static_cast<double>(maxLength)));
+
+        out.clear();
+        while (out.size() < length)
+        {
+            if (!out.empty()) out += ' ';
+            out += WORDS[random.Below(std::size(WORDS))];
+        }
+        out.resize(length);
+
+        //Leading and trailing spaces would not survive an export/import round trip
+        while (!out.empty() and out.back() == ' ') out.pop_back();
+        if (out.empty()) out.push_back('x');
+    }
+
+    void Emit(const std::vector<Shape>& shapes, uint32_t shape, uint32_t lineNumber, Random& random,
+        const Generator::Options& options, std::string& previous, LineTree& tree)
+    {
+        const uint32_t node = tree.nodes.size();
+
+        std::string text;
+        if (lineNumber > 1 and random.Unit() < options.collisions) text = previous;
+        else                                                       Text(random, options, text);
+
+        tree.nodes.push_back({lineNumber, 0, static_cast<uint32_t>(tree.texts.size()), static_cast<uint32_t>(text.size())});
+        tree.texts += text;
+        previous    = std::move(text);
+
+        std::string previousChild;
+        uint32_t    childLine = 1;
+        for (const uint32_t child : shapes[shape].children)
+        {
+            Emit(shapes, child, childLine++, random, options, previousChild, tree);
+        }
+        tree.nodes[node].end = tree.nodes.size();
+    }
+}
+
+LineTree
+Generator::Generate(const Options& options)
+{
+    Random random(options.seed);
+
+    //Shape first, breadth first so the total is spread over every level, then texts in preorder
+    std::vector<Shape>   shapes;
+    std::vector<uint32_t> topLevel;
+    std::deque<uint32_t>  open;
+
+    shapes.reserve(options.lines);
+    const auto add = [&](uint32_t depth)
+    {
+        shapes.push_back({depth, {}});
+        const uint32_t id = shapes.size() - 1;
+        if (depth < options.depth and random.Unit() < options.blocks) open.push_back(id);
+        return id;
+    };
+
+    const uint32_t breadth = std::max(options.breadth, 1u);
+    while (shapes.size() < options.lines)
+    {
+        if (open.empty())
+        {
+            topLevel.push_back(add(0));
+            continue;
+        }
+
+        const uint32_t block = open.front();
+        open.pop_front();
+
+        const uint32_t lines = std::min<uint32_t>(1 + random.Below(breadth), options.lines - shapes.size());
+        for (uint32_t i = 0; i < lines; i += 1)
+        {
+            const uint32_t child = add(shapes[block].depth + 1);
+            shapes[block].children.push_back(child);
+        }
+    }
+
+    LineTree tree;
+    tree.nodes.reserve(shapes.size());
+    tree.texts.reserve(static_cast<std::size_t>(shapes.size()) * options.meanLength);
+
+    std::string previous;
+    uint32_t    lineNumber = 1;
+    for (const uint32_t line : topLevel)
+    {
+        Emit(shapes, line, lineNumber++, random, options, previous, tree);
+    }
+    return tree;
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "Memory.hpp"
+
+using Memory = zkb::Memory;
+
+namespace
+{
+    struct Totals
+    {
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> liveBlocks{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> peakBytes{0};
+    };
+
+    //Constant initialized, allocations made before main are counted too
+    std::array<Totals, Memory::COUNT> totals;
+}
+
+#if ALLOCATION_TRACKING
+namespace
+{
+    //Keeps the block after it aligned like malloc's
+    struct alignas(alignof(std::max_align_t)) Header
+    {
+        std::size_t       size;
+        Memory::Subsystem subsystem;
+    };
+
+    void* Allocate(std::size_t size) noexcept
+    {
+        auto* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+        if (header == nullptr) return nullptr;
+
+        header->size      = size;
+        header->subsystem = Memory::current;
+
+        auto& total = totals[header->subsystem];
+        const uint64_t live = total.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        total.liveBlocks.fetch_add(1, std::memory_order_relaxed);
+        total.allocations.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t peak = total.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak and !total.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+
+        return header + 1;
+    }
+
+    void Free(void* pointer) noexcept
+    {
+        if (pointer == nullptr) return;
+
+        auto* header = static_cast<Header*>(pointer) - 1;
+        auto& total  = totals[header->subsystem];
+        total.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        total.liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+
+        std::free(header);
+    }
+
+    void* AllocateOrThrow(std::size_t size)
+    {
+        while (true)
+        {
+            if (void* pointer = Allocate(size)) return pointer;
+
+            const auto handler = std::get_new_handler();
+            if (handler == nullptr) throw std::bad_alloc();
+            handler();
+        }
+    }
+}
+
+//The align_val_t overloads are left to the library, they allocate and free on their own
+void* operator new(std::size_t size)                                    { return AllocateOrThrow(size); }
+void* operator new[](std::size_t size)                                  { return AllocateOrThrow(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept    { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept  { return Allocate(size); }
+
+void operator delete(void* pointer) noexcept                            { Free(pointer); }
+void operator delete[](void* pointer) noexcept                          { Free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept               { Free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept             { Free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept     { Free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept   { Free(pointer); }
+#endif
+
+Memory::Usage
+Memory::Get(Subsystem subsystem)
+{
+    const auto& total = totals[subsystem];
+    return
+    {
+        total.liveBytes.load(std::memory_order_relaxed),
+        total.liveBlocks.load(std::memory_order_relaxed),
+        total.allocations.load(std::memory_order_relaxed),
+        total.peakBytes.load(std::memory_order_relaxed),
+    };
+}
+
+std::string
+Memory::Report()
+{
+    if constexpr (!enabled)
+    {
+        return "Allocation tracking is off, configure with -DZKB_ALLOCATIONS=ON\n";
+    }
+
+    using ULL = unsigned long long;
+
+    std::string out;
+    char        row[160];
+
+    std::snprintf(row, sizeof(row), "%-9s %14s %12s %14s %14s\n",
+        "subsystem", "live_bytes", "live_blocks", "allocations", "peak_bytes");
+    out += row;
+
+    Usage sum{};
+    for (uint32_t i = 0; i < COUNT; i += 1)
+    {
+        const auto usage = Get(static_cast<Subsystem>(i));
+        sum.liveBytes   += usage.liveBytes;
+        sum.liveBlocks  += usage.liveBlocks;
+        sum.allocations += usage.allocations;
+
+        std::snprintf(row, sizeof(row), "%-9.*s %14llu %12llu %14llu %14llu\n",
+            static_cast<int>(names[i].size()), names[i].data(),
+            ULL{usage.liveBytes}, ULL{usage.liveBlocks}, ULL{usage.allocations}, ULL{usage.peakBytes});
+        out += row;
+    }
+
+    //Peaks of different subsystems happen at different times, they aren't summed
+    std::snprintf(row, sizeof(row), "%-9s %14llu %12llu %14llu\n", "total",
+        ULL{sum.liveBytes}, ULL{sum.liveBlocks}, ULL{sum.allocations});
+    out += row;
+    return out;
+}
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BlockListing.hpp"
+#include "Counters.hpp"
+#include "Directory.hpp"
+#include "ProjectIO.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+namespace fs = zkb::fs;
+
+namespace
+{
+    constexpr uint32_t TAB_WIDTH = 4;
+
+    //Export output is handed to the stream in chunks of this size
+    constexpr std::size_t EXPORT_CHUNK = 1 << 16;
+    //Import creates the parsed lines once this many are buffered, at the next top level line
+    constexpr std::size_t IMPORT_CHUNK = 1 << 16;
+
+    using LineTree = zkb::ProjectIO::LineTree;
+
+    /*
+     * Parses input into trees of whole top level lines and hands each one to create,
+     * numbered from 1, once it holds IMPORT_CHUNK lines and when input ends. Memory
+     * stays bounded by the chunk, or by the largest top level line when it has more.
+     */
+    template <typename Func>
+    bool Parse(std::istream& input, Func&& create)
+    {
+        struct Level
+        {
+            uint32_t indent;
+            uint32_t node;
+            uint32_t children;
+        };
+
+        LineTree           tree;
+        std::vector<Level> stack;
+        uint32_t topLevelLines = 0;
+        uint32_t sourceLine    = 0;
+
+        auto close = [&]()
+        {
+            tree.nodes[stack.back().node].end = tree.nodes.size();
+            stack.pop_back();
+        };
+
+        std::string line;
+        while (std::getline(input, line))
+        {
+            sourceLine += 1;
+
+            uint32_t    indent = 0;
+            std::size_t begin  = 0;
+            for (; begin < line.size() and (line[begin] == ' ' or line[begin] == '\t'); begin += 1)
+            {
+                indent += line[begin] == '\t'? TAB_WIDTH : 1;
+            }
+
+            std::size_t end = line.size();
+            while (end > begin and std::isspace(static_cast<unsigned char>(line[end - 1]))) end -= 1;
+
+            //Blank lines have no depth to attach to, they are dropped
+            if (begin == end) continue;
+
+            const std::string_view text(line.data() + begin, end - begin);
+            if (text.find('/') != std::string_view::npos)
+            {
+                std::cerr << "Line " << sourceLine << ": '/' can't be part of a line name\n";
+                return false;
+            }
+
+            while (!stack.empty() and stack.back().indent >= indent) close();
+
+            if (stack.empty() and tree.nodes.size() >= IMPORT_CHUNK)
+            {
+                if (!create(std::move(tree))) return false;
+                tree          = {};
+                topLevelLines = 0;
+            }
+
+            //Room for the line number and the space
+            if (text.size() + 11 > NAME_MAX)
+            {
+                std::cerr << "Line " << sourceLine << ": too long to be a line name\n";
+                return false;
+            }
+
+            const uint32_t lineNumber = stack.empty()? ++topLevelLines : ++stack.back().children;
+            tree.nodes.push_back({lineNumber, 0, static_cast<uint32_t>(tree.texts.size()), static_cast<uint32_t>(text.size())});
+            tree.texts += text;
+
+            stack.push_back({indent, static_cast<uint32_t>(tree.nodes.size() - 1), 0});
+        }
+
+        while (!stack.empty()) close();
+        return tree.nodes.empty() or create(std::move(tree));
+    }
+
+    //Creates the nodes (siblings) in [begin, end) inside dirfd, leaves as files under hybrid storage
+    bool CreateSubtrees(int dirfd, const LineTree& tree, uint32_t begin, uint32_t end, uint32_t lineOffset, bool hybrid)
+    {
+        std::string name;
+        for (uint32_t i = begin; i < end; i = tree.nodes[i].end)
+        {
+            const auto& node = tree.nodes[i];
+            name  = std::to_string(node.lineNumber + lineOffset);
+            name += ' ';
+            name += tree.Text(node);
+
+            const bool leaf = node.end == i + 1;
+            zkb::Counters::Add(zkb::Counters::Mkdirs);
+            if (leaf and hybrid)
+            {
+                const int fd = openat(dirfd, name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+                if (fd < 0)
+                {
+                    std::cerr << "Can't create " << name << ": " << std::strerror(errno) << '\n';
+                    return false;
+                }
+                close(fd);
+                continue;
+            }
+
+            if (mkdirat(dirfd, name.c_str(), 0755) != 0)
+            {
+                std::cerr << "Can't create " << name << ": " << std::strerror(errno) << '\n';
+                return false;
+            }
+
+            if (leaf) continue;
+
+            const int childfd = openat(dirfd, name.c_str(), O_RDONLY | O_DIRECTORY);
+            if (childfd < 0)
+            {
+                std::cerr << "Can't open " << name << ": " << std::strerror(errno) << '\n';
+                return false;
+            }
+
+            const bool created = CreateSubtrees(childfd, tree, i + 1, node.end, 0, hybrid);
+            close(childfd);
+            if (!created) return false;
+        }
+        return true;
+    }
+
+    //Appends the lines of the block at path, and their subtrees, to tree
+    void ReadBlock(const fs::path& path, LineTree& tree)
+    {
+        const zkb::BlockListing listing(path);
+        for (const auto line : listing)
+        {
+            const uint32_t node = tree.nodes.size();
+            const auto     text = line.Name();
+
+            tree.nodes.push_back({line.lineNumber, 0, static_cast<uint32_t>(tree.texts.size()), static_cast<uint32_t>(text.size())});
+            tree.texts += text;
+
+            if (line.isBlock) ReadBlock(path / line.filename, tree);
+            tree.nodes[node].end = tree.nodes.size();
+        }
+    }
+
+    //Only the listings of the blocks on the current path are alive at a time
+    bool ExportBlock(const fs::path& path, uint32_t depth, std::string& buffer, std::ostream& out)
+    {
+        const zkb::BlockListing listing(path);
+        for (const auto line : listing)
+        {
+            buffer.append(depth * TAB_WIDTH, ' ');
+            buffer += line.Name();
+            buffer += '\n';
+
+            if (buffer.size() >= EXPORT_CHUNK)
+            {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+                if (!out) return false;
+            }
+
+            if (line.isBlock and !ExportBlock(path / line.filename, depth + 1, buffer, out)) return false;
+        }
+        return true;
+    }
+}
+
+std::string_view
+zkb::ProjectIO::LineTree::Text(const Node& node) const
+{
+    return std::string_view(texts).substr(node.textOffset, node.textLength);
+}
+
+uint32_t
+zkb::ProjectIO::LineTree::NumberOfTopLevelLines() const
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < nodes.size(); i = nodes[i].end) count += 1;
+    return count;
+}
+
+zkb::ProjectIO::LineTree
+zkb::ProjectIO::ReadLines(const fs::path& block, uint32_t first, uint32_t last)
+{
+    const BlockListing listing(block);
+
+    std::vector<std::future<LineTree>> jobs;
+    for (auto i = listing.LowerBound(first); i < listing.Size() and listing[i].lineNumber <= last; i += 1)
+    {
+        jobs.push_back(ThreadPool::Shared().Submit([&block, line = listing[i]]()
+        {
+            LineTree tree;
+            const auto text = line.Name();
+            tree.nodes.push_back({0, 0, 0, static_cast<uint32_t>(text.size())});
+            tree.texts = text;
+
+            if (line.isBlock) ReadBlock(block / line.filename, tree);
+            tree.nodes[0].end = tree.nodes.size();
+            return tree;
+        }));
+    }
+
+    //Subtrees are merged in line order and the top level renumbered 1, 2, ...
+    LineTree out;
+    for (auto& job : jobs)
+    {
+        const auto     tree       = job.get();
+        const uint32_t nodeOffset = out.nodes.size();
+        const uint32_t textOffset = out.texts.size();
+
+        for (auto node : tree.nodes)
+        {
+            node.end        += nodeOffset;
+            node.textOffset += textOffset;
+            out.nodes.push_back(node);
+        }
+        out.nodes[nodeOffset].lineNumber = out.NumberOfTopLevelLines();
+        out.texts += tree.texts;
+    }
+    return out;
+}
+
+bool
+zkb::ProjectIO::CreateLines(const LineTree& tree, const fs::path& destination, uint32_t firstLineNumber)
+{
+    //A leaf file gets its first children
+    if (!Directory::PromoteLine(destination))
+    {
+        std::cerr << "Can't open " << destination.string() << " as a block\n";
+        return false;
+    }
+
+    Trace::Span span("create", "fs");
+    span.Arg("lines", tree.nodes.size());
+
+    const bool hybrid = Directory::HybridStorage(FindRoot(destination));
+    const int  rootfd = open(destination.c_str(), O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0)
+    {
+        std::cerr << "Can't open " << destination.string() << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    //One job per top level line, each creates its whole subtree
+    std::vector<std::future<bool>> jobs;
+    for (uint32_t i = 0; i < tree.nodes.size(); i = tree.nodes[i].end)
+    {
+        jobs.push_back(ThreadPool::Shared().Submit([&tree, rootfd, i, firstLineNumber, hybrid]()
+        {
+            return CreateSubtrees(rootfd, tree, i, i + 1, firstLineNumber - 1, hybrid);
+        }));
+    }
+
+    bool success = true;
+    for (auto& job : jobs)
+    {
+        success = job.get() and success;
+    }
+    close(rootfd);
+    return success;
+}
+
+fs::path
+zkb::ProjectIO::FindRoot(const fs::path& path)
+{
+    for (fs::path current = path; !current.empty(); current = current.parent_path())
+    {
+        if (current.extension() == ".zkb") return current;
+        if (current == current.parent_path()) break;
+    }
+    return {};
+}
+
+bool
+zkb::ProjectIO::Import(const fs::path& file, const fs::path& destination)
+{
+    std::ifstream input(file);
+    if (!input)
+    {
+        std::cerr << "Can't open " << file.string() << '\n';
+        return false;
+    }
+    return Import(input, destination);
+}
+
+bool
+zkb::ProjectIO::Import(std::istream& input, const fs::path& destination)
+{
+    const auto start{std::chrono::steady_clock::now()};
+
+    uint32_t lastLine = 0;
+    Directory::ForEachLine([&](const LineView& view)
+    {
+        lastLine = std::max(lastLine, view.lineNumber);
+    }, destination);
+
+    //Lines are created a chunk at a time while parsing, not after reading the whole input
+    std::size_t imported = 0;
+    const bool  success  = Parse(input, [&](LineTree&& tree)
+    {
+        const bool created = CreateLines(tree, destination, lastLine + 1);
+        lastLine += tree.NumberOfTopLevelLines();
+        imported += tree.nodes.size();
+        return created;
+    });
+
+    //Nothing was created if the first chunk didn't parse
+    if (!success and imported == 0) return false;
+
+    const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+    std::cout << (success? "Imported " : "Partially imported ") << imported << " lines in "
+        << elapsed.count() << "s\n";
+    return success;
+}
+
+bool
+zkb::ProjectIO::Export(const fs::path& source, std::ostream& out)
+{
+    std::string buffer;
+    buffer.reserve(EXPORT_CHUNK + NAME_MAX * 2);
+
+    if (!ExportBlock(source, 0, buffer, out)) return false;
+
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    return static_cast<bool>(out);
+}
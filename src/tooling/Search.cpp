@@ -0,0 +1,87 @@
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BlockListing.hpp"
+#include "Search.hpp"
+#include "ThreadPool.hpp"
+
+namespace fs = zkb::fs;
+
+namespace
+{
+    using Matcher = std::function<bool(std::string_view)>;
+
+    void SearchBlock(const fs::path& path, std::string& linePath, const Matcher& matches, std::vector<zkb::Search::Match>& out)
+    {
+        const zkb::BlockListing listing(path);
+        for (const auto line : listing)
+        {
+            const auto previousSize = linePath.size();
+            linePath += '/';
+            linePath += std::to_string(line.lineNumber);
+
+            if (matches(line.Name()))
+            {
+                out.push_back({linePath.substr(1), std::string(line.Name())});
+            }
+
+            if (line.isBlock) SearchBlock(path / line.filename, linePath, matches, out);
+            linePath.resize(previousSize);
+        }
+    }
+}
+
+std::vector<zkb::Search::Match>
+zkb::Search::Find(const fs::path& root, const Query& query)
+{
+    Matcher matches;
+    if (query.regex)
+    {
+        auto regex = std::make_shared<const std::regex>(query.pattern, std::regex::ECMAScript | std::regex::optimize);
+        matches = [regex](std::string_view text)
+        {
+            return std::regex_search(text.begin(), text.end(), *regex);
+        };
+    }
+    else
+    {
+        matches = [pattern = query.pattern](std::string_view text)
+        {
+            return text.find(pattern) != std::string_view::npos;
+        };
+    }
+
+    const BlockListing listing(root);
+    std::vector<std::future<std::vector<Match>>> jobs;
+    jobs.reserve(listing.Size());
+
+    for (const auto line : listing)
+    {
+        jobs.push_back(ThreadPool::Shared().Submit([&matches, &root, line]()
+        {
+            std::vector<Match> out;
+            std::string linePath = '/' + std::to_string(line.lineNumber);
+
+            if (matches(line.Name()))
+            {
+                out.push_back({linePath.substr(1), std::string(line.Name())});
+            }
+
+            if (line.isBlock) SearchBlock(root / line.filename, linePath, matches, out);
+            return out;
+        }));
+    }
+
+    std::vector<Match> found;
+    for (auto& job : jobs)
+    {
+        auto matchesOfLine = job.get();
+        found.insert(found.end(), std::make_move_iterator(matchesOfLine.begin()), std::make_move_iterator(matchesOfLine.end()));
+    }
+    return found;
+}
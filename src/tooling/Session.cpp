@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include "BlockListing.hpp"
+#include "CommandHandler.hpp"
+#include "Directory.hpp"
+#include "ProjectIO.hpp"
+#include "Session.hpp"
+#include "SharedProject.hpp"
+
+namespace fs = zkb::fs;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "ZKBSESSION 1";
+
+    std::ofstream recording;
+
+    //Value of a "key value" header line
+    bool Field(std::istream& input, std::string_view key, std::string& value)
+    {
+        std::string line;
+        if (!std::getline(input, line) or !line.starts_with(key) or line.size() <= key.size() or line[key.size()] != ' ')
+        {
+            return false;
+        }
+        value = line.substr(key.size() + 1);
+        return true;
+    }
+
+    struct Timing
+    {
+        std::string command;
+        double      micros;
+    };
+
+    void Report(const std::vector<Timing>& timings)
+    {
+        std::string out;
+        char        row[128];
+
+        out += "    #      time_us  command\n";
+        for (std::size_t i = 0; i < timings.size(); i += 1)
+        {
+            std::snprintf(row, sizeof(row), "%5zu %12.1f  ", i + 1, timings[i].micros);
+            out += row;
+            out += timings[i].command;
+            out += '\n';
+        }
+
+        struct Word
+        {
+            std::vector<double> samples;
+            double              total = 0;
+        };
+
+        std::map<std::string, Word> byWord;
+        double total = 0;
+        for (const auto& timing : timings)
+        {
+            auto& word = byWord[timing.command.substr(0, timing.command.find(' '))];
+            word.samples.push_back(timing.micros);
+            word.total += timing.micros;
+            total      += timing.micros;
+        }
+
+        //Command words by time spent
+        std::vector<std::pair<std::string, Word>> words(byWord.begin(), byWord.end());
+        std::sort(words.begin(), words.end(), [](const auto& a, const auto& b) { return a.second.total > b.second.total; });
+
+        out += "\ncommand     runs     total_ms    median_us\n";
+        for (auto& [name, word] : words)
+        {
+            std::sort(word.samples.begin(), word.samples.end());
+            std::snprintf(row, sizeof(row), "%-8.8s %7zu %12.2f %12.1f\n", name.c_str(), word.samples.size(),
+                word.total / 1000, word.samples[word.samples.size() / 2]);
+            out += row;
+        }
+
+        std::snprintf(row, sizeof(row), "\nTotal: %zu commands in %.2f ms\n", timings.size(), total / 1000);
+        out += row;
+
+        std::cout.write(out.data(), out.size());
+    }
+}
+
+bool
+zkb::Session::Record(const fs::path& file)
+{
+    recording.open(file, std::ios::binary | std::ios::trunc);
+    if (!recording)
+    {
+        std::cerr << "Can't record session to " << file.string() << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool
+zkb::Session::Recording()
+{
+    return recording.is_open();
+}
+
+void
+zkb::Session::Begin(const fs::path& root, const fs::path& block)
+{
+    if (!Recording()) return;
+
+    std::ostringstream tree;
+    ProjectIO::Export(root, tree);
+    const auto snapshot = std::move(tree).str();
+
+    auto relative = block.lexically_relative(root);
+    if (relative.empty()) relative = ".";
+
+    recording << MAGIC << '\n'
+              << "root "   << root.string()     << '\n'
+              << "block "  << relative.string() << '\n'
+              << "hybrid " << Directory::HybridStorage(root) << '\n'
+              << "tree "   << snapshot.size()   << '\n';
+    recording.write(snapshot.data(), snapshot.size());
+    recording << "commands\n" << std::flush;
+}
+
+void
+zkb::Session::Log(std::string_view command)
+{
+    if (!Recording()) return;
+
+    recording.write(command.data(), command.size());
+    recording.put('\n');
+    recording.flush();
+}
+
+int
+zkb::Session::Replay(const fs::path& file, const ReplayOptions& options)
+{
+    std::ifstream input(file, std::ios::binary);
+
+    std::string magic, root, block, hybrid, size;
+    if (!std::getline(input, magic) or magic != MAGIC or !Field(input, "root", root) or !Field(input, "block", block) or
+        !Field(input, "hybrid", hybrid) or !Field(input, "tree", size))
+    {
+        std::cerr << file.string() << " is not a session log\n";
+        return EXIT_FAILURE;
+    }
+
+    std::string snapshot(std::stoull(size), '\0');
+    std::string marker;
+    if (!input.read(snapshot.data(), snapshot.size()) or !std::getline(input, marker) or marker != "commands")
+    {
+        std::cerr << file.string() << " is truncated\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> commands;
+    for (std::string command; std::getline(input, command);) commands.push_back(std::move(command));
+
+    //Scratch copy named like the original so prompts and relative paths look the same
+    const fs::path scratch = options.directory / ("zkb-replay-" + std::to_string(getpid()));
+    const fs::path copy    = scratch / fs::path(root).filename();
+
+    std::error_code err;
+    fs::remove_all(scratch, err);
+    fs::create_directories(copy, err);
+    if (err)
+    {
+        std::cerr << "Can't create " << copy.string() << ": " << err.message() << '\n';
+        return EXIT_FAILURE;
+    }
+    if (hybrid == "1") std::ofstream{copy / ".hybrid"};
+
+    std::istringstream tree(std::move(snapshot));
+    if (!ProjectIO::Import(tree, copy)) return EXIT_FAILURE;
+
+    fs::path start = (copy / block).lexically_normal();
+    if (!fs::is_directory(start, err))
+    {
+        std::cerr << "Block " << block << " is not in the snapshot, starting at the root\n";
+        start = copy;
+    }
+
+    const auto previous = fs::current_path();
+    fs::current_path(start);
+    CommandHandler::rootPath  = copy;
+    CommandHandler::basedPath = start;
+    Directory::updateNumberOfDirs = true;
+    BlockListing::Invalidate();
+
+    std::vector<Timing> timings;
+    timings.reserve(commands.size());
+    {
+        //Output is discarded and prompts read nothing, which answers no
+        std::ostringstream sink;
+        std::istringstream empty;
+        auto* coutBuffer = std::cout.rdbuf(sink.rdbuf());
+        auto* cerrBuffer = std::cerr.rdbuf(sink.rdbuf());
+        auto* cinBuffer  = std::cin.rdbuf(empty.rdbuf());
+
+        CommandHandler handler(false);
+        handler.showPrompt = false;
+
+        for (const auto& command : commands)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            const bool quit  = handler.Execute(command);
+            const auto end   = std::chrono::steady_clock::now();
+
+            timings.push_back({command, std::chrono::duration<double, std::micro>{end - begin}.count()});
+            sink.str({});
+            std::cin.clear();
+            if (quit) break;
+        }
+
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        std::cin.rdbuf(cinBuffer);
+    }
+
+    fs::current_path(previous);
+    SharedProject::Remove(copy);
+    if (options.keep) std::cout << "Scratch copy kept at " << copy.string() << '\n';
+    else              fs::remove_all(scratch, err);
+
+    Report(timings);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CommandHandler.hpp"
+#include "SharedProject.hpp"
+
+using SharedProject = zkb::SharedProject;
+namespace fs = zkb::fs;
+
+namespace
+{
+    constexpr uint64_t MAGIC = 0x324A5250424B5AULL; //"ZKBPRJ2"
+
+    //Stable across builds, unlike std::hash, so every zkb binary agrees on the name
+    std::string ObjectName(const fs::path& root)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : root.native())
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "/zkb-%016llx", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    std::unique_ptr<SharedProject> active;
+    bool                           activeLoaded = false;
+}
+
+SharedProject::SharedProject(fs::path root) :
+    root(std::move(root))
+{
+    const auto name = ObjectName(this->root);
+
+    struct stat st;
+    while (true)
+    {
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) return;
+
+        //The first session sizes and initializes the object, later ones wait for it on the lock
+        flock(fd, LOCK_EX);
+
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            fd = -1;
+            return;
+        }
+
+        //The last session detached and unlinked it after we opened it, attach to a new one
+        if (st.st_nlink > 0) break;
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    const bool fresh = st.st_size != sizeof(Shared);
+    if (fresh and ftruncate(fd, sizeof(Shared)) != 0)
+    {
+        flock(fd, LOCK_UN);
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    void* memory = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        flock(fd, LOCK_UN);
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    shared = static_cast<Shared*>(memory);
+    if (fresh or shared->magic != MAGIC)
+    {
+        shared = new (memory) Shared{};
+        shared->magic = MAGIC;
+    }
+    shared->attached += 1;
+    seen = shared->generation.load(std::memory_order_acquire);
+
+    flock(fd, LOCK_UN);
+}
+
+SharedProject::~SharedProject()
+{
+    if (shared != nullptr)
+    {
+        //Under the lock, so no session attaches between the last detach and the unlink
+        flock(fd, LOCK_EX);
+        shared->attached -= 1;
+        if (shared->attached == 0) shm_unlink(ObjectName(root).c_str());
+        munmap(shared, sizeof(Shared));
+    }
+    if (fd >= 0) close(fd);
+}
+
+SharedProject*
+SharedProject::Active()
+{
+    if (!activeLoaded)
+    {
+        activeLoaded = true;
+
+        active = std::make_unique<SharedProject>(CommandHandler::rootPath);
+        if (!active->IsOpen())
+        {
+            std::cerr << "Shared memory unavailable, concurrent sessions won't be coordinated\n";
+            active.reset();
+        }
+    }
+    return active.get();
+}
+
+void
+SharedProject::Remove(const fs::path& root)
+{
+    if (active != nullptr and active->root == root)
+    {
+        active.reset();
+        activeLoaded = false;
+    }
+    shm_unlink(ObjectName(root).c_str());
+}
+
+bool
+SharedProject::IsOpen() const
+{
+    return shared != nullptr;
+}
+
+void
+SharedProject::Suspend()
+{
+    if (lockDepth > 0) flock(fd, LOCK_UN);
+}
+
+bool
+SharedProject::Resume()
+{
+    if (lockDepth == 0) return true;
+
+    flock(fd, LOCK_EX);
+    return shared->generation.load(std::memory_order_acquire) == seen;
+}
+
+bool
+SharedProject::Changes(std::vector<fs::path>& changed)
+{
+    const std::size_t initialSize = changed.size();
+
+    while (true)
+    {
+        const uint64_t sequence = shared->sequence.load(std::memory_order_acquire);
+        if (sequence % 2 == 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const uint64_t generation = shared->generation.load(std::memory_order_relaxed);
+        if (generation == seen) return true;
+
+        bool overflow = generation - seen > RING_SIZE;
+        changed.resize(initialSize);
+
+        for (uint64_t g = seen + 1; g <= generation and !overflow; g += 1)
+        {
+            const Slot& slot = shared->slots[g % RING_SIZE];
+            if (slot.generation != g or slot.length > MAX_PATH)
+            {
+                overflow = true;
+                break;
+            }
+            changed.push_back(root / std::string_view(slot.path, slot.length));
+        }
+
+        //Seqlock read side: the copy is only valid if no writer started meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared->sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        seen = generation;
+        if (overflow) changed.resize(initialSize);
+        return !overflow;
+    }
+}
+
+void
+SharedProject::Publish(const fs::path& block)
+{
+    const auto relative = block.lexically_relative(root);
+    const auto& native  = relative.native() == "."? std::string() : relative.native();
+
+    const uint64_t sequence   = shared->sequence.load(std::memory_order_relaxed);
+    const uint64_t generation = shared->generation.load(std::memory_order_relaxed) + 1;
+
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot& slot = shared->slots[generation % RING_SIZE];
+    slot.generation = generation;
+    if (native.size() <= MAX_PATH)
+    {
+        slot.length = native.size();
+        std::memcpy(slot.path, native.data(), native.size());
+    }
+    else
+    {
+        slot.length = UINT16_MAX;
+    }
+
+    shared->generation.store(generation, std::memory_order_relaxed);
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+
+    //This session already knows about its own edit
+    seen = generation;
+}
+
+SharedProject::WriteLock::WriteLock(SharedProject& project, fs::path block) :
+    project(project),
+    block(std::move(block))
+{
+    if (project.lockDepth == 0) flock(project.fd, LOCK_EX);
+    project.lockDepth += 1;
+}
+
+SharedProject::WriteLock::~WriteLock()
+{
+    auto& pending = project.pending;
+    if (std::find(pending.begin(), pending.end(), block) == pending.end())
+    {
+        pending.push_back(std::move(block));
+    }
+
+    project.lockDepth -= 1;
+    if (project.lockDepth > 0) return;
+
+    for (const auto& edited : pending)
+    {
+        project.Publish(edited);
+    }
+    pending.clear();
+    flock(project.fd, LOCK_UN);
+}
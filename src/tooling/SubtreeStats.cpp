@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "Directory.hpp"
+#include "SubtreeStats.hpp"
+#include "ThreadPool.hpp"
+
+using SubtreeStats = zkb::SubtreeStats;
+namespace fs = zkb::fs;
+
+namespace
+{
+    struct Entry
+    {
+        timespec     modified;
+        SubtreeStats stats;
+    };
+
+    std::mutex                          cacheMutex;
+    std::unordered_map<uint64_t, Entry> cache;
+
+    struct Child
+    {
+        uint32_t    lineNumber;
+        uint64_t    inode;
+        timespec    modified;
+        std::string filename;
+    };
+
+    bool SameTime(const timespec& a, const timespec& b)
+    {
+        return a.tv_sec == b.tv_sec and a.tv_nsec == b.tv_nsec;
+    }
+
+    auto Children(const fs::path& path)
+      -> std::vector<Child>
+    {
+        std::vector<Child> children;
+        zkb::Directory::ForEachLine([&](const zkb::LineView& view)
+        {
+            struct stat st;
+            const timespec modified = fstatat(view.dirfd, view.filename.data(), &st, 0) == 0? st.st_mtim : timespec{};
+            children.push_back({view.lineNumber, view.inode, modified, std::string(view.filename)});
+        }, path);
+
+        std::sort(children.begin(), children.end(), [](const Child& a, const Child& b) { return a.lineNumber < b.lineNumber; });
+        return children;
+    }
+
+    void Merge(SubtreeStats& stats, const SubtreeStats& child, uint32_t lineNumber)
+    {
+        stats.lines += child.lines;
+        if (child.ownLines > 0) stats.depth = std::max(stats.depth, child.depth + 1);
+
+        for (const auto& block : child.largest)
+        {
+            stats.largest.push_back({block.lines, block.linePath == "."?
+                std::to_string(lineNumber) : std::to_string(lineNumber) + '/' + block.linePath});
+        }
+
+        std::stable_sort(stats.largest.begin(), stats.largest.end(), [](const auto& a, const auto& b) { return a.lines > b.lines; });
+        if (stats.largest.size() > SubtreeStats::LARGEST_BLOCKS) stats.largest.resize(SubtreeStats::LARGEST_BLOCKS);
+    }
+
+    auto Compute(const fs::path& path, const std::vector<Child>& children, bool parallel)
+      -> SubtreeStats;
+
+    auto Cached(const fs::path& path, uint64_t inode, const timespec& modified)
+      -> SubtreeStats
+    {
+        {
+            std::lock_guard lock(cacheMutex);
+            auto it = cache.find(inode);
+            if (it != cache.end() and SameTime(it->second.modified, modified)) return it->second.stats;
+        }
+
+        auto stats = Compute(path, Children(path), false);
+
+        std::lock_guard lock(cacheMutex);
+        cache.insert_or_assign(inode, Entry{modified, stats});
+        return stats;
+    }
+
+    auto Compute(const fs::path& path, const std::vector<Child>& children, bool parallel)
+      -> SubtreeStats
+    {
+        SubtreeStats stats;
+        stats.ownLines = children.size();
+        stats.lines    = children.size();
+        stats.depth    = !children.empty();
+        if (!children.empty()) stats.largest.push_back({stats.ownLines, "."});
+
+        if (!parallel)
+        {
+            for (const auto& child : children)
+            {
+                Merge(stats, Cached(path / child.filename, child.inode, child.modified), child.lineNumber);
+            }
+            return stats;
+        }
+
+        std::vector<std::future<SubtreeStats>> jobs;
+        jobs.reserve(children.size());
+        for (const auto& child : children)
+        {
+            jobs.push_back(zkb::ThreadPool::Shared().Submit([&path, &child]()
+            {
+                return Cached(path / child.filename, child.inode, child.modified);
+            }));
+        }
+
+        for (std::size_t i = 0; i < jobs.size(); i += 1)
+        {
+            Merge(stats, jobs[i].get(), children[i].lineNumber);
+        }
+        return stats;
+    }
+}
+
+SubtreeStats
+SubtreeStats::Of(const fs::path& block)
+{
+    struct stat st;
+    if (stat(block.c_str(), &st) != 0) return {};
+
+    {
+        std::lock_guard lock(cacheMutex);
+        auto it = cache.find(st.st_ino);
+        if (it != cache.end() and SameTime(it->second.modified, st.st_mtim)) return it->second.stats;
+    }
+
+    auto stats = Compute(block, Children(block), true);
+
+    std::lock_guard lock(cacheMutex);
+    cache.insert_or_assign(st.st_ino, Entry{st.st_mtim, stats});
+    return stats;
+}
+
+void
+SubtreeStats::Invalidate()
+{
+    std::lock_guard lock(cacheMutex);
+    cache.clear();
+}
+
+void
+SubtreeStats::Invalidate(const fs::path& block, const fs::path& root)
+{
+    std::lock_guard lock(cacheMutex);
+    for (fs::path path = block; ; path = path.parent_path())
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) cache.erase(st.st_ino);
+
+        if (path == root or path == path.parent_path()) break;
+    }
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "ThreadPool.hpp"
+
+using ThreadPool = zkb::ThreadPool;
+
+ThreadPool::ThreadPool(uint32_t numberOfThreads)
+{
+    numberOfThreads = std::max<uint32_t>(numberOfThreads, 1);
+
+    workers.reserve(numberOfThreads);
+    for (uint32_t i = 0; i < numberOfThreads; i += 1)
+    {
+        workers.emplace_back(&ThreadPool::Run, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+uint32_t
+ThreadPool::Size() const
+{
+    return workers.size();
+}
+
+ThreadPool&
+ThreadPool::Shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void
+ThreadPool::Run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this]() { return stopping or !tasks.empty(); });
+
+            if (tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
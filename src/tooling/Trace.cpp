@@ -0,0 +1,146 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include <unistd.h>
+
+#include "Trace.hpp"
+#include "Utils.hpp"
+
+using Trace = zkb::Trace;
+
+std::atomic<bool> Trace::enabled = false;
+
+namespace
+{
+    //Events are handed to the file in chunks of this size
+    constexpr std::size_t FLUSH_SIZE = 1 << 16;
+
+    std::mutex  traceMutex;
+    std::FILE*  file   = nullptr;
+    std::string buffer;
+    bool        first  = true;
+
+    const auto epoch = std::chrono::steady_clock::now();
+
+    uint32_t ThreadId()
+    {
+        static std::atomic<uint32_t> next = 1;
+        thread_local const uint32_t  id   = next.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    uint64_t Micros(std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch).count();
+    }
+
+    void Flush()
+    {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+}
+
+bool
+Trace::Start(const fs::path& path)
+{
+    std::lock_guard lock(traceMutex);
+    if (file != nullptr) return true;
+
+    file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        std::cerr << "Can't write trace to " << path.string() << '\n';
+        return false;
+    }
+
+    buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    first  = true;
+    enabled.store(true, std::memory_order_relaxed);
+
+    //Application::Exit leaves through exit(), the file is still completed
+    std::atexit(Stop);
+    return true;
+}
+
+void
+Trace::Stop()
+{
+    std::lock_guard lock(traceMutex);
+    if (file == nullptr) return;
+
+    enabled.store(false, std::memory_order_relaxed);
+    buffer += "\n]}\n";
+    Flush();
+    std::fclose(file);
+    file = nullptr;
+}
+
+Trace::Span::Span(std::string_view name, std::string_view category) :
+    active(Enabled()),
+    name(name),
+    category(category)
+{
+    if (active) start = std::chrono::steady_clock::now();
+}
+
+void
+Trace::Span::Arg(std::string_view key, uint64_t value)
+{
+    if (!active) return;
+
+    if (!args.empty()) args += ',';
+    args += '"';
+    args += key;
+    args += "\":";
+    args += std::to_string(value);
+}
+
+void
+Trace::Span::Arg(std::string_view key, std::string_view value)
+{
+    if (!active) return;
+
+    if (!args.empty()) args += ',';
+    args += '"';
+    args += key;
+    args += "\":\"";
+    args += JsonEscape(value);
+    args += '"';
+}
+
+Trace::Span::~Span()
+{
+    if (!active) return;
+
+    const auto end = std::chrono::steady_clock::now();
+
+    char event[160];
+    std::snprintf(event, sizeof(event), "{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%llu,\"dur\":%llu,",
+        static_cast<int>(getpid()), ThreadId(), static_cast<unsigned long long>(Micros(start)),
+        static_cast<unsigned long long>(Micros(end) - Micros(start)));
+
+    std::lock_guard lock(traceMutex);
+    if (file == nullptr) return;
+
+    if (!first) buffer += ",\n";
+    first = false;
+
+    buffer += event;
+    buffer += "\"name\":\"";
+    buffer += JsonEscape(name);
+    buffer += "\",\"cat\":\"";
+    buffer += category;
+    buffer += "\",\"args\":{";
+    buffer += args;
+    buffer += "}}";
+
+    if (buffer.size() >= FLUSH_SIZE) Flush();
+}
@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "CommandHandler.hpp"
+#include "Directory.hpp"
+#include "ThreadPool.hpp"
+#include "TrigramIndex.hpp"
+
+using TrigramIndex = zkb::TrigramIndex;
+namespace fs = zkb::fs;
+
+namespace
+{
+    constexpr char MAGIC[8] = {'Z', 'K', 'B', 'T', 'R', 'I', '1', '\n'};
+
+    timespec ModifiedTime(const fs::path& path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return {};
+        return st.st_mtim;
+    }
+
+    bool SameTime(const timespec& a, const timespec& b)
+    {
+        return a.tv_sec == b.tv_sec and a.tv_nsec == b.tv_nsec;
+    }
+
+    uint32_t Trigram(std::string_view text, std::size_t i)
+    {
+        return static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[i + 2]));
+    }
+
+    template <typename T>
+    void Write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool Read(std::istream& in, T& value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+}
+
+std::unique_ptr<TrigramIndex> TrigramIndex::active       = nullptr;
+bool                          TrigramIndex::activeLoaded = false;
+
+std::string_view
+TrigramIndex::Node::Text() const
+{
+    const auto space = filename.find(' ');
+    return space == std::string::npos? std::string_view(filename) : std::string_view(filename).substr(space + 1);
+}
+
+TrigramIndex::TrigramIndex(fs::path _root) :
+    root(std::move(_root))
+{
+}
+
+fs::path
+TrigramIndex::FilePath(const fs::path& root)
+{
+    return root.parent_path() / (root.filename().string() + ".trigrams");
+}
+
+TrigramIndex*
+TrigramIndex::Active()
+{
+    if (!activeLoaded)
+    {
+        activeLoaded = true;
+
+        const auto& root = CommandHandler::rootPath;
+        if (fs::exists(FilePath(root)))
+        {
+            active = std::make_unique<TrigramIndex>(root);
+            if (!active->Load())
+            {
+                std::cerr << "Trigram index is unreadable, rebuilding\n";
+                active->Build();
+                active->Save();
+            }
+        }
+    }
+    return active.get();
+}
+
+TrigramIndex*
+TrigramIndex::Create(const fs::path& root)
+{
+    activeLoaded = true;
+    active       = std::make_unique<TrigramIndex>(root);
+    active->Build();
+    active->Save();
+    return active.get();
+}
+
+void
+TrigramIndex::Remove(const fs::path& root)
+{
+    std::error_code err;
+    fs::remove(FilePath(root), err);
+
+    activeLoaded = true;
+    active.reset();
+}
+
+void
+TrigramIndex::FlushActive()
+{
+    if (active != nullptr) active->Flush();
+}
+
+void
+TrigramIndex::Build()
+{
+    nodes.clear();
+    children.clear();
+    postings.clear();
+    aliveNodes = 0;
+
+    AddNode(NO_NODE, 0, 0, "");
+    Reconcile(0, root);
+}
+
+uint32_t
+TrigramIndex::AddNode(uint32_t parent, uint32_t lineNumber, uint64_t inode, std::string filename)
+{
+    const uint32_t id = nodes.size();
+    nodes.push_back({parent, lineNumber, inode, {}, std::move(filename), true});
+    children.emplace_back();
+    aliveNodes += 1;
+
+    IndexText(id);
+    return id;
+}
+
+void
+TrigramIndex::IndexText(uint32_t node)
+{
+    const auto text = nodes[node].Text();
+    for (std::size_t i = 0; i + 3 <= text.size(); i += 1)
+    {
+        auto& list = postings[Trigram(text, i)];
+        if (list.empty() or list.back() != node) list.push_back(node);
+    }
+}
+
+void
+TrigramIndex::Kill(uint32_t node)
+{
+    if (!nodes[node].alive) return;
+
+    nodes[node].alive = false;
+    aliveNodes -= 1;
+
+    for (uint32_t child : children[node]) Kill(child);
+    children[node].clear();
+}
+
+void
+TrigramIndex::Reconcile(uint32_t node, const fs::path& path)
+{
+    std::unordered_map<uint64_t, uint32_t> existing;
+    for (uint32_t child : children[node])
+    {
+        if (nodes[child].alive) existing.emplace(nodes[child].inode, child);
+    }
+
+    std::vector<uint32_t> current;
+    std::vector<uint32_t> added;
+
+    Directory::ForEachLine([&](const LineView& view)
+    {
+        auto it = existing.find(view.inode);
+        if (it == existing.end())
+        {
+            const uint32_t id = AddNode(node, view.lineNumber, view.inode, std::string(view.filename));
+            current.push_back(id);
+            added.push_back(id);
+            return;
+        }
+
+        auto& child = nodes[it->second];
+        child.lineNumber = view.lineNumber;
+        if (child.filename != view.filename)
+        {
+            const bool textChanged = child.Text() != view.name;
+            child.filename = view.filename;
+            if (textChanged) IndexText(it->second);
+        }
+
+        current.push_back(it->second);
+        existing.erase(it);
+    }, path);
+
+    for (const auto& [inode, child] : existing) Kill(child);
+
+    children[node]        = std::move(current);
+    nodes[node].modified  = ModifiedTime(path);
+    dirty                 = true;
+
+    for (uint32_t child : added)
+    {
+        Reconcile(child, path / nodes[child].filename);
+    }
+}
+
+uint32_t
+TrigramIndex::NodeAt(const fs::path& block) const
+{
+    const auto relative = block.lexically_relative(root);
+    if (relative.empty() or *relative.begin() == "..") return NO_NODE;
+
+    uint32_t node = 0;
+    for (const auto& component : relative)
+    {
+        if (component == ".") continue;
+
+        const auto name = component.string();
+        const auto it   = std::find_if(children[node].begin(), children[node].end(), [&](uint32_t child)
+        {
+            return nodes[child].alive and nodes[child].filename == name;
+        });
+
+        if (it == children[node].end()) return NO_NODE;
+        node = *it;
+    }
+    return node;
+}
+
+void
+TrigramIndex::Refresh(const fs::path& block)
+{
+    //A block the index doesn't know yet is picked up by its closest known ancestor
+    for (fs::path path = block; ; path = path.parent_path())
+    {
+        const uint32_t node = NodeAt(path);
+        if (node != NO_NODE)
+        {
+            Reconcile(node, path);
+            return;
+        }
+        if (path == root or path == path.parent_path()) return;
+    }
+}
+
+void
+TrigramIndex::CheckModified()
+{
+    //Only stats, every line of the root is checked as a separate job
+    std::function<void(uint32_t, const fs::path&, std::vector<uint32_t>&)> collect;
+    collect = [&](uint32_t node, const fs::path& path, std::vector<uint32_t>& stale)
+    {
+        if (!SameTime(ModifiedTime(path), nodes[node].modified))
+        {
+            stale.push_back(node);
+        }
+        for (uint32_t child : children[node])
+        {
+            collect(child, path / nodes[child].filename, stale);
+        }
+    };
+
+    std::vector<uint32_t> stale;
+    if (!SameTime(ModifiedTime(root), nodes[0].modified)) stale.push_back(0);
+
+    std::vector<std::future<std::vector<uint32_t>>> jobs;
+    for (uint32_t child : children[0])
+    {
+        jobs.push_back(ThreadPool::Shared().Submit([&, child]()
+        {
+            std::vector<uint32_t> out;
+            collect(child, root / nodes[child].filename, out);
+            return out;
+        }));
+    }
+
+    for (auto& job : jobs)
+    {
+        const auto out = job.get();
+        stale.insert(stale.end(), out.begin(), out.end());
+    }
+
+    //Parents come before their children, a reconciled parent may kill a stale child
+    for (uint32_t node : stale)
+    {
+        if (!nodes[node].alive) continue;
+
+        std::vector<std::string> components;
+        for (uint32_t current = node; current != 0; current = nodes[current].parent)
+        {
+            components.push_back(nodes[current].filename);
+        }
+
+        fs::path path = root;
+        for (auto it = components.rbegin(); it != components.rend(); ++it) path /= *it;
+
+        Reconcile(node, path);
+    }
+}
+
+void
+TrigramIndex::CheckTopLevel()
+{
+    bool modified = !SameTime(ModifiedTime(root), nodes[0].modified);
+    for (uint32_t child : children[0])
+    {
+        if (modified) break;
+        if (!nodes[child].alive) continue;
+
+        modified = !SameTime(ModifiedTime(root / nodes[child].filename), nodes[child].modified);
+    }
+
+    if (modified) CheckModified();
+}
+
+void
+TrigramIndex::RebuildPostings()
+{
+    postings.clear();
+    for (uint32_t node = 0; node < nodes.size(); node += 1)
+    {
+        if (nodes[node].alive) IndexText(node);
+    }
+}
+
+void
+TrigramIndex::Compact()
+{
+    std::vector<Node>                  compacted;
+    std::vector<std::vector<uint32_t>> compactedChildren;
+    compacted.reserve(aliveNodes);
+    compactedChildren.reserve(aliveNodes);
+
+    //Preorder, parents are always written before their children
+    std::function<void(uint32_t, uint32_t)> copy = [&](uint32_t node, uint32_t parent)
+    {
+        const uint32_t id = compacted.size();
+        compacted.push_back(std::move(nodes[node]));
+        compacted.back().parent = parent;
+        compactedChildren.emplace_back();
+        if (parent != NO_NODE) compactedChildren[parent].push_back(id);
+
+        for (uint32_t child : children[node]) copy(child, id);
+    };
+    copy(0, NO_NODE);
+
+    nodes      = std::move(compacted);
+    children   = std::move(compactedChildren);
+    aliveNodes = nodes.size();
+    RebuildPostings();
+}
+
+bool
+TrigramIndex::Save()
+{
+    Compact();
+
+    const auto path      = FilePath(root);
+    const auto temporary = fs::path(path.string() + ".tmp");
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out) return false;
+
+        out.write(MAGIC, sizeof(MAGIC));
+        Write<uint32_t>(out, nodes.size());
+        for (const auto& node : nodes)
+        {
+            Write(out, node.parent);
+            Write(out, node.lineNumber);
+            Write(out, node.inode);
+            Write<int64_t>(out, node.modified.tv_sec);
+            Write<int64_t>(out, node.modified.tv_nsec);
+            Write<uint32_t>(out, node.filename.size());
+            out.write(node.filename.data(), node.filename.size());
+        }
+
+        Write<uint32_t>(out, postings.size());
+        for (const auto& [trigram, list] : postings)
+        {
+            Write(out, trigram);
+            Write<uint32_t>(out, list.size());
+            out.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(uint32_t));
+        }
+
+        if (!out) return false;
+    }
+
+    std::error_code err;
+    fs::rename(temporary, path, err);
+    dirty = static_cast<bool>(err);
+    return !err;
+}
+
+void
+TrigramIndex::Flush()
+{
+    if (dirty) Save();
+}
+
+bool
+TrigramIndex::Load()
+{
+    std::ifstream in(FilePath(root), std::ios::binary);
+
+    char magic[sizeof(MAGIC)];
+    if (!in.read(magic, sizeof(magic)) or !std::equal(magic, magic + sizeof(magic), MAGIC)) return false;
+
+    uint32_t numberOfNodes;
+    if (!Read(in, numberOfNodes) or numberOfNodes == 0) return false;
+
+    nodes.assign(numberOfNodes, {});
+    children.assign(numberOfNodes, {});
+    for (uint32_t id = 0; id < numberOfNodes; id += 1)
+    {
+        auto&    node = nodes[id];
+        int64_t  seconds, nanoseconds;
+        uint32_t length;
+
+        if (!Read(in, node.parent) or !Read(in, node.lineNumber) or !Read(in, node.inode) or
+            !Read(in, seconds) or !Read(in, nanoseconds) or !Read(in, length)) return false;
+
+        node.modified = {static_cast<time_t>(seconds), static_cast<long>(nanoseconds)};
+        node.alive    = true;
+        node.filename.resize(length);
+        if (!in.read(node.filename.data(), length)) return false;
+
+        if (id == 0) continue;
+        if (node.parent >= id) return false;
+        children[node.parent].push_back(id);
+    }
+    aliveNodes = numberOfNodes;
+
+    uint32_t numberOfTrigrams;
+    if (!Read(in, numberOfTrigrams)) return false;
+
+    postings.clear();
+    postings.reserve(numberOfTrigrams);
+    for (uint32_t i = 0; i < numberOfTrigrams; i += 1)
+    {
+        uint32_t trigram, length;
+        if (!Read(in, trigram) or !Read(in, length)) return false;
+
+        auto& list = postings[trigram];
+        list.resize(length);
+        if (!in.read(reinterpret_cast<char*>(list.data()), length * sizeof(uint32_t))) return false;
+        if (std::any_of(list.begin(), list.end(), [&](uint32_t node) { return node >= numberOfNodes; })) return false;
+    }
+
+    dirty = false;
+    CheckModified();
+    return true;
+}
+
+std::vector<uint32_t>
+TrigramIndex::LineNumbers(uint32_t node) const
+{
+    std::vector<uint32_t> lineNumbers;
+    for (; node != 0; node = nodes[node].parent)
+    {
+        lineNumbers.push_back(nodes[node].lineNumber);
+    }
+    std::reverse(lineNumbers.begin(), lineNumbers.end());
+    return lineNumbers;
+}
+
+std::vector<zkb::Search::Match>
+TrigramIndex::Find(const Search::Query& query) const
+{
+    std::vector<uint32_t> found;
+
+    if (!query.regex and query.pattern.size() >= 3)
+    {
+        //Candidates from the shortest posting list, verified against the text
+        const std::vector<uint32_t>* shortest = nullptr;
+        for (std::size_t i = 0; i + 3 <= query.pattern.size(); i += 1)
+        {
+            auto it = postings.find(Trigram(query.pattern, i));
+            if (it == postings.end()) return {};
+
+            if (shortest == nullptr or it->second.size() < shortest->size()) shortest = &it->second;
+        }
+
+        for (uint32_t node : *shortest)
+        {
+            if (nodes[node].alive and nodes[node].Text().find(query.pattern) != std::string_view::npos)
+            {
+                found.push_back(node);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+    }
+    else
+    {
+        std::function<bool(std::string_view)> matches;
+        if (query.regex)
+        {
+            matches = [regex = std::regex(query.pattern, std::regex::ECMAScript | std::regex::optimize)](std::string_view text)
+            {
+                return std::regex_search(text.begin(), text.end(), regex);
+            };
+        }
+        else
+        {
+            matches = [&](std::string_view text) { return text.find(query.pattern) != std::string_view::npos; };
+        }
+
+        for (uint32_t node = 1; node < nodes.size(); node += 1)
+        {
+            if (nodes[node].alive and matches(nodes[node].Text())) found.push_back(node);
+        }
+    }
+
+    std::vector<std::pair<std::vector<uint32_t>, uint32_t>> ordered;
+    ordered.reserve(found.size());
+    for (uint32_t node : found)
+    {
+        ordered.emplace_back(LineNumbers(node), node);
+    }
+    std::sort(ordered.begin(), ordered.end());
+
+    std::vector<Search::Match> out;
+    out.reserve(ordered.size());
+    for (const auto& [lineNumbers, node] : ordered)
+    {
+        std::string linePath;
+        for (uint32_t lineNumber : lineNumbers)
+        {
+            if (!linePath.empty()) linePath += '/';
+            linePath += std::to_string(lineNumber);
+        }
+        out.push_back({std::move(linePath), std::string(nodes[node].Text())});
+    }
+    return out;
+}
+
+uint32_t
+TrigramIndex::NumberOfLines() const
+{
+    return aliveNodes - 1;
+}
+
+const fs::path&
+TrigramIndex::Root() const
+{
+    return root;
+}
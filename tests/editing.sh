@@ -0,0 +1,126 @@
+#!/usr/bin/env bash
+# Scripted editing sessions, each checked against the tree it leaves behind.
+# Use: tests/editing.sh path/to/zkb
+set -uo pipefail
+
+zkb=$(realpath "$1")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+# Runs the commands on stdin in a new project called name, with the rest of the
+# arguments as zkb's, then compares its tree (one relative path per line, sorted)
+# with expected
+check()
+{
+    local name=$1 expected=$2
+    local project="$work/$name.zkb"
+    shift 2
+
+    mkdir -p "$project"
+    (cd "$project" && "$zkb" "$@" > /dev/null 2>&1)
+
+    local actual
+    actual=$(cd "$project" && find . -mindepth 1 | sed 's|^\./||' | LC_ALL=C sort)
+    if [[ "$actual" != "$expected" ]]; then
+        echo "FAIL $name"
+        diff <(echo "$expected") <(echo "$actual")
+        failures=$((failures + 1))
+    else
+        echo "ok   $name"
+    fi
+}
+
+# Lines of equal text are renumbered without merging into each other
+check insert-repeated "1 a
+2 c
+3 c
+4 c
+5 b" <<'COMMANDS'
+l a
+l b
+l c 2
+l c 2
+l c 2
+COMMANDS
+
+check delete-before-repeated "1 b
+2 c
+3 c
+4 c" <<'COMMANDS'
+l a
+l b
+3 l c
+d 1
+COMMANDS
+
+check delete-range "1 b
+2 c" <<'COMMANDS'
+l a
+l b
+l b
+l c
+-d (1,2)
+COMMANDS
+
+# Undoing a put removes the pasted subtrees and leaves the tree as it was
+check put-undo "1 a
+2 b
+2 b/1 x
+2 b/2 y
+3 c" <<'COMMANDS'
+l a
+l b
+l c
+cd 2
+l x
+l y
+cd ..
+y (1,2)
+p 4
+u
+COMMANDS
+
+check delete-nested "1 b" <<'COMMANDS'
+l a
+l b
+cd 1
+l x
+cd 1
+l deep
+cd /
+-d 1
+COMMANDS
+
+# Undo recreates a deleted subtree one line per undo, parents before their children
+check delete-nested-undo "1 a
+2 b
+2 b/1 x
+2 b/1 x/1 deep
+2 b/2 y
+3 c" <<'COMMANDS'
+l a
+l b
+l c
+cd 2
+l x
+l y
+cd 1
+l deep
+cd /
+-d 2
+u
+u
+u
+u
+COMMANDS
+
+# Without a prompt a y/n question is answered no, the next line stays a command
+check json-no-prompt "1 a
+2 b" --json <<'COMMANDS'
+l a
+l foo 99
+l b
+COMMANDS
+
+exit $((failures != 0))